@@ -3,100 +3,244 @@
 #include <chrono>
 #include <pthread.h>
 #include <omp.h>
+#include "matrix.h"
+#include "strassen.h"
+#include "backend.h"
+#include "sparse.h"
+#include "gemm_narrow.h"
+#include "affinity.h"
+#include "gemm_batched.h"
+#include "gemm_fixed.h"
+#include "matrix_io.h"
+#include "counter_rng.h"
 
 #define N 100 // Matrix size 
 #define NUM_THREADS 4
+#define STRASSEN_CUTOFF 512 // Below this size Strassen falls back to the blocked kernel
+#define BATCH_SIZE 256 // Independent N x N products in the batched run
 
 using namespace std;
 using namespace chrono;
 
-vector<vector<int>> A(N, vector<int>(N));
-vector<vector<int>> B(N, vector<int>(N));
-vector<vector<int>> C_seq(N, vector<int>(N, 0));
-vector<vector<int>> C_pthread(N, vector<int>(N, 0));
-vector<vector<int>> C_openmp(N, vector<int>(N, 0));
-
-// Function to initialize matrices with random values
-void initialize_matrices() {
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            A[i][j] = rand() % 10;
-            B[i][j] = rand() % 10;
-        }
-    }
+// Allocated in main by allocate_matrices, after the threads are pinned
+Matrix<int> A, B, C_seq, C_pthread, C_openmp, C_strassen, C_auto;
+
+// First touch in the same round-robin row strips (gemm_row_chunk), on the
+// same workers, as executor_multiplication, so each worker's rows sit on its
+// own NUMA node
+void allocate_matrices(Executor& exec) {
+    Matrix<int>* matrices[] = { &A, &B, &C_seq, &C_pthread, &C_openmp, &C_strassen, &C_auto };
+    for (Matrix<int>* m : matrices) m->resize(N, N, false);
+
+    exec.parallel_for_static(N, gemm_row_chunk(N, exec.threads()), [&](size_t begin, size_t end) {
+        for (Matrix<int>* m : matrices) memset((*m)[begin], 0, sizeof(int) * (end - begin) * N);
+    });
 }
 
-// Sequential Matrix Multiplication
-void sequential_multiplication() {
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            for (int k = 0; k < N; k++) {
-                C_seq[i][j] += A[i][k] * B[k][j];
+// Function to initialize matrices with random values. Each entry is a
+// function of the seed and its position only, so the row strips are filled in
+// parallel (same strips and workers as the first touch) and the matrices are
+// the same for any thread count. density 1.0 keeps the original 0-9 fill.
+void initialize_matrices(Executor& exec, uint64_t seed, double density) {
+    uint64_t seedA = counter_rng_stream(seed, 0), seedB = counter_rng_stream(seed, 1);
+    exec.parallel_for_static(N, gemm_row_chunk(N, exec.threads()), [&](size_t begin, size_t end) {
+        for (int r = (int)begin; r < (int)end; r++) {
+            if (density >= 1.0) {
+                counter_rng_fill(A[r], N, (size_t)r * N, seedA, 10);
+                counter_rng_fill(B[r], N, (size_t)r * N, seedB, 10);
+                continue;
+            }
+            for (int j = 0; j < N; j++) {
+                A[r][j] = sparse_random_entry(seedA, (size_t)r * N + j, density);
+                B[r][j] = sparse_random_entry(seedB, (size_t)r * N + j, density);
             }
         }
-    }
+    });
 }
 
-// Thread function for Pthreads parallel multiplication
-struct ThreadData {
-    int start_row, end_row;
-};
-
-void* pthread_multiplication(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    for (int i = data->start_row; i < data->end_row; i++) {
-        for (int j = 0; j < N; j++) {
-            for (int k = 0; k < N; k++) {
-                C_pthread[i][j] += A[i][k] * B[k][j];
-            }
-        }
+// Copy an N x N matrix file (see matrix_io.h) into `m`. The file is mapped,
+// so this is one memcpy out of the page cache.
+bool load_matrix(const char* path, Matrix<int>& m) {
+    MappedMatrix<int> file;
+    if (!file.open(path)) return false;
+    if (file.rows() != (size_t)N || file.cols() != (size_t)N) {
+        cerr << path << ": expected " << N << " x " << N << ", found " << file.rows() << " x " << file.cols() << endl;
+        return false;
     }
-    return NULL;
+    memcpy(m.data(), file.data(), m.size() * sizeof(int));
+    return true;
 }
 
-// OpenMP Parallel Matrix Multiplication
-void openmp_multiplication() {
-    #pragma omp parallel for num_threads(NUM_THREADS)
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            for (int k = 0; k < N; k++) {
-                C_openmp[i][j] += A[i][k] * B[k][j];
-            }
+// C = A * B on any executor (backend.h): sequential, Pthreads pool or
+// OpenMP. Row strips of gemm_row_chunk rows (a multiple of GEMM_MR, about
+// four per worker) are dealt round-robin; a GEMM_MC block would be all of
+// N = 100 rows and leave every other worker idle. Worker t (pinned like
+// OpenMP thread t) gets the strips it first-touched in allocate_matrices, so
+// its rows are local: the Pthreads and OpenMP executors have the same thread
+// count and so the same strips. Dynamic chunks would not follow that
+// placement, so the pool's static deal is used here.
+void executor_multiplication(Executor& exec, Matrix<int>& C) {
+    exec.parallel_for_static(N, gemm_row_chunk(N, exec.threads()), [&C](size_t begin, size_t end) {
+        gemm_rows(A, B, C, (int)begin, (int)end);
+    });
+}
+
+int main(int argc, char** argv) {
+    // Arguments: [density] [--input A.bin B.bin] [--save-inputs A.bin B.bin] [--output C.bin]
+    // density is the fraction of nonzero random entries; --input replaces the
+    // random A and B with matrix files, --output keeps the sequential result
+    double density = 1.0;
+    const char *inputA = NULL, *inputB = NULL, *saveA = NULL, *saveB = NULL, *output = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--input") == 0 && i + 2 < argc) {
+            inputA = argv[++i];
+            inputB = argv[++i];
+        } else if (strcmp(argv[i], "--save-inputs") == 0 && i + 2 < argc) {
+            saveA = argv[++i];
+            saveB = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            density = atof(argv[i]);
         }
     }
-}
 
-int main() {
-    initialize_matrices();
+    // Pin the workers (AFFINITY=compact|scatter|none) before any page is
+    // touched; the Pthreads pool is started once, outside the timed regions
+    AffinityPolicy placement = affinity_policy_from_env();
+    cout << "Thread placement: " << affinity_describe(placement) << endl;
+    Executor sequential(BACKEND_SERIAL);
+    Executor openmp(BACKEND_OPENMP, NUM_THREADS, placement);
+    Executor pthreads(BACKEND_PTHREADS, NUM_THREADS, placement);
+    allocate_matrices(openmp);
+    initialize_matrices(openmp, counter_rng_seed(1), density);  // RNG_SEED=n picks other inputs
+    if (inputA && !(load_matrix(inputA, A) && load_matrix(inputB, B))) return 1;
+    if (saveA && !(matrix_write(saveA, A.data(), N, N) && matrix_write(saveB, B.data(), N, N))) return 1;
 
     // Sequential Execution
     auto start = high_resolution_clock::now();
-    sequential_multiplication();
+    executor_multiplication(sequential, C_seq);
     auto stop = high_resolution_clock::now();
     cout << "Sequential Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
+    if (output && !matrix_write(output, C_seq.data(), N, N)) return 1;
 
     // Pthreads Execution
-    pthread_t threads[NUM_THREADS];
-    ThreadData thread_data[NUM_THREADS];
-    int rows_per_thread = N / NUM_THREADS;
-
     start = high_resolution_clock::now();
-    for (int i = 0; i < NUM_THREADS; i++) {
-        thread_data[i].start_row = i * rows_per_thread;
-        thread_data[i].end_row = (i + 1) * rows_per_thread;
-        pthread_create(&threads[i], NULL, pthread_multiplication, (void*)&thread_data[i]);
-    }
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_join(threads[i], NULL);
-    }
+    executor_multiplication(pthreads, C_pthread);
     stop = high_resolution_clock::now();
-    cout << "Pthreads Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
+    cout << "Pthreads Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms"
+         << (memcmp(C_pthread.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+         << endl;
 
     // OpenMP Execution
     start = high_resolution_clock::now();
-    openmp_multiplication();
+    executor_multiplication(openmp, C_openmp);
+    stop = high_resolution_clock::now();
+    cout << "OpenMP Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms"
+         << (memcmp(C_openmp.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+         << endl;
+
+    // Strassen-Winograd Execution (pays off for N >= 2048)
+    start = high_resolution_clock::now();
+    strassen_multiply(A, B, C_strassen, STRASSEN_CUTOFF, NUM_THREADS);
     stop = high_resolution_clock::now();
-    cout << "OpenMP Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
+    cout << "Strassen Execution Time: " << duration_cast<milliseconds>(stop - start).count() << " ms"
+         << (memcmp(C_strassen.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+         << endl;
+
+    // Density-routed Execution: CSR SpMM when A is mostly zeros, else the dense kernel
+    start = high_resolution_clock::now();
+    bool sparse = multiply_auto(A.data(), B.data(), C_auto.data(), N, N, N, [] { gemm_rows(A, B, C_auto, 0, N); });
+    stop = high_resolution_clock::now();
+    cout << "Auto-routed Execution Time (" << (sparse ? "sparse CSR" : "dense") << ", A density "
+         << matrix_density(A.data(), N, N, N) << "): " << duration_cast<milliseconds>(stop - start).count() << " ms"
+         << (memcmp(C_auto.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+         << endl;
+
+    // Narrow-input Execution: the same product with A and B stored in the
+    // narrowest integer type that holds them, accumulated in int
+    NarrowType narrow = gemm_narrow_type(A.data(), A.size(), B.data(), B.size(), N);
+    if (narrow == NARROW_OVERFLOW) {
+        cout << "Narrow Execution skipped: products can overflow an int32 accumulator" << endl;
+    } else if (narrow != NARROW_INT32) {
+        Matrix<int> C_narrow(N, N);
+        start = high_resolution_clock::now();
+        if (narrow == NARROW_INT8) {
+            vector<int8_t> a = narrow_copy<int8_t>(A.data(), A.size()), b = narrow_copy<int8_t>(B.data(), B.size());
+            gemm_narrow(N, N, N, a.data(), N, b.data(), N, C_narrow.data(), N);
+        } else {
+            vector<int16_t> a = narrow_copy<int16_t>(A.data(), A.size()), b = narrow_copy<int16_t>(B.data(), B.size());
+            gemm_narrow(N, N, N, a.data(), N, b.data(), N, C_narrow.data(), N);
+        }
+        stop = high_resolution_clock::now();
+        cout << "Narrow Execution Time (" << narrow_type_name(narrow) << " inputs): "
+             << duration_cast<milliseconds>(stop - start).count() << " ms"
+             << (memcmp(C_narrow.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+             << endl;
+    }
+
+    // Fixed-size Execution: N is a compile-time constant, so the whole
+    // product compiles to one specialized, unrolled kernel
+    {
+        Matrix<int> C_fixed(N, N);
+        start = high_resolution_clock::now();
+        gemm_fixed<N, N, N>(A.data(), B.data(), C_fixed.data());
+        stop = high_resolution_clock::now();
+        cout << "Fixed-size Execution Time: " << duration_cast<microseconds>(stop - start).count() << " us"
+             << (memcmp(C_fixed.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0 ? "" : "  MISMATCH vs sequential")
+             << endl;
+    }
+
+    // Batched Execution: BATCH_SIZE independent products (each A_b is A with
+    // its first element changed, all sharing B) in one call, against one
+    // OpenMP region per matrix
+    {
+        size_t elements = (size_t)N * N;
+        vector<int> batchA(BATCH_SIZE * elements), batchC(BATCH_SIZE * elements), loopC(BATCH_SIZE * elements);
+        for (int b = 0; b < BATCH_SIZE; b++) {
+            memcpy(&batchA[b * elements], A.data(), sizeof(int) * elements);
+            batchA[b * elements] = b % 10;
+        }
+
+        start = high_resolution_clock::now();
+        for (int b = 0; b < BATCH_SIZE; b++) {
+            openmp.parallel_for_static(N, gemm_row_chunk(N, openmp.threads()), [&](size_t begin, size_t end) {
+                gemm_batch_item(N, N, &batchA[b * elements], N, B.data(), N, &loopC[b * elements], N,
+                                (int)begin, (int)end);
+            });
+        }
+        stop = high_resolution_clock::now();
+        cout << "Per-matrix OpenMP Time (" << BATCH_SIZE << " products): "
+             << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
+
+        for (Executor* exec : { &sequential, &pthreads, &openmp }) {
+            start = high_resolution_clock::now();
+            gemm_strided_batched(*exec, BATCH_SIZE, N, N, N, batchA.data(), N, (long)elements,
+                                 B.data(), N, 0L, batchC.data(), N, (long)elements);
+            stop = high_resolution_clock::now();
+            cout << "Batched " << backend_name(exec->backend()) << " Time: "
+                 << duration_cast<milliseconds>(stop - start).count() << " ms"
+                 << (batchC == loopC ? "" : "  MISMATCH vs per-matrix") << endl;
+        }
+    }
+
+    // Micro-kernel variants: rerun the sequential multiply on each ISA this
+    // CPU supports and check it against C_seq
+    GemmIsa dispatched = gemm_active_isa();
+    cout << "Dispatched micro-kernel: " << gemm_isa_name(dispatched) << endl;
+    for (int isa = ISA_SCALAR; isa < ISA_COUNT; isa++) {
+        if (!gemm_isa_supported((GemmIsa)isa)) continue;
+        gemm_set_isa((GemmIsa)isa);
+        Matrix<int> C_isa(N, N);
+        start = high_resolution_clock::now();
+        gemm_rows(A, B, C_isa, 0, N);
+        stop = high_resolution_clock::now();
+        double seconds = duration<double>(stop - start).count();
+        bool match = memcmp(C_isa.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0;
+        cout << gemm_isa_name((GemmIsa)isa) << ": " << 2.0 * N * N * N / seconds / 1e9 << " GOP/s"
+             << (match ? "" : "  MISMATCH vs sequential") << endl;
+    }
+    gemm_set_isa(dispatched);
 
     return 0;
 }
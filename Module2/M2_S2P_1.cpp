@@ -2,39 +2,47 @@
 #include <cstdlib>
 #include <iostream>
 #include <time.h>
+#include "backend.h"
+#include "counter_rng.h"
+#include "hugepage_alloc.h"
 
 using namespace std::chrono;
 using namespace std;
 
-// Function to fill a vector with random integers
-void randomVector(int vector[], int size) {
-  for (int i = 0; i < size; i++) {
-    vector[i] = rand() % 100;  // Assigning a random number between 0-99
-  }
-}
-
-int main() {
+int main(int argc, char** argv) {
   unsigned long size = 100000000;  // Size of vectors (100 million elements)
-  srand(time(0));  // Seed random number generator
+  uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
+
+  // Serial unless --backend NAME or BACKEND says otherwise (backend.h)
+  Executor exec(backend_select(argc, argv, BACKEND_SERIAL));
+  cout << "Backend: " << backend_name(exec.backend()) << ", " << exec.threads() << " thread(s)" << endl;
 
   int *v1, *v2, *v3;
   
   // Measure execution time
   auto start = high_resolution_clock::now();
 
-  // Dynamically allocate memory for large vectors
-  v1 = (int *)malloc(size * sizeof(int));
-  v2 = (int *)malloc(size * sizeof(int));
-  v3 = (int *)malloc(size * sizeof(int));
+  // Dynamically allocate memory for large vectors, on huge pages where the
+  // system allows (HUGEPAGES=off for ordinary pages)
+  HugePageKind pages;
+  v1 = hugepage_alloc_array<int>(size, &pages);
+  v2 = hugepage_alloc_array<int>(size);
+  v3 = hugepage_alloc_array<int>(size);
+  if (!v1 || !v2 || !v3) {
+    cerr << "Failed to allocate " << size << "-element vectors" << endl;
+    return 1;
+  }
 
-  // Fill vectors with random values
-  randomVector(v1, size);
-  randomVector(v2, size);
+  // Fill vectors with random values between 0-99. Counter-based
+  // (counter_rng.h), so the data for a seed is the same on every backend
+  backend_random_fill(exec, v1, size, counter_rng_stream(seed, 0), 100);
+  backend_random_fill(exec, v2, size, counter_rng_stream(seed, 1), 100);
 
-  // Perform vector addition
-  for (int i = 0; i < size; i++) {
-    v3[i] = v1[i] + v2[i];
-  }
+  // Perform vector addition; v3 is not read again here, so it is written
+  // with streaming stores
+  auto add_start = high_resolution_clock::now();
+  backend_vector_add(exec, v1, v2, v3, size);
+  auto add_stop = high_resolution_clock::now();
 
   // Stop timing
   auto stop = high_resolution_clock::now();
@@ -42,11 +50,14 @@ int main() {
 
   // Output execution time
   cout << "Time taken by function: " << duration.count() << " microseconds" << endl;
+  double add_seconds = std::chrono::duration<double>(add_stop - add_start).count();
+  cout << "Vector addition: " << (long)(add_seconds * 1e6) << " microseconds, "
+       << add_bandwidth_gbs(size, add_seconds) << " GB/s (" << hugepage_kind_name(pages) << ")" << endl;
 
   // Free allocated memory
-  free(v1);
-  free(v2);
-  free(v3);
+  hugepage_free_array(v1, size);
+  hugepage_free_array(v2, size);
+  hugepage_free_array(v3, size);
 
   return 0;
 }
@@ -1,76 +1,65 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
-#include <thread>
-#include <vector>
+#include "affinity.h"
+#include "backend.h"
+#include "counter_rng.h"
+#include "hugepage_alloc.h"
 
 using namespace std;
 using namespace std::chrono;
 
 const int NUM_THREADS = 8;  // Adjust based on your system
 
-void randomVector(int vector[], int start, int end) {
-  for (int i = start; i < end; i++) {
-    vector[i] = rand() % 100;  // Assign random numbers
-  }
-}
-
-void vectorAdd(int v1[], int v2[], int v3[], int start, int end) {
-  for (int i = start; i < end; i++) {
-    v3[i] = v1[i] + v2[i];
-  }
-}
-
-int main() {
+int main(int argc, char** argv) {
   unsigned long size = 100000000;
-  srand(time(0));
+  uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
 
-  int *v1, *v2, *v3;
-  v1 = (int *)malloc(size * sizeof(int));
-  v2 = (int *)malloc(size * sizeof(int));
-  v3 = (int *)malloc(size * sizeof(int));
+  AffinityPolicy placement = affinity_policy_from_env();  // AFFINITY=compact|scatter|none
+  cout << "Thread placement: " << affinity_describe(placement) << endl;
 
-  auto start = high_resolution_clock::now();
+  // std::thread per loop unless --backend NAME or BACKEND picks another
+  // executor (backend.h). Worker i is pinned under the placement policy; on
+  // the threads and openmp backends it gets the same block for filling and
+  // adding, so the pages it touches first are the ones it reads later, on
+  // its own NUMA node.
+  Executor exec(backend_select(argc, argv, BACKEND_THREADS), NUM_THREADS, placement);
+  cout << "Backend: " << backend_name(exec.backend()) << ", " << exec.threads() << " thread(s)" << endl;
 
-  // Create threads to fill vectors in parallel
-  vector<thread> threads;
-  int chunk_size = size / NUM_THREADS;
-
-  for (int i = 0; i < NUM_THREADS; i++) {
-    int start_idx = i * chunk_size;
-    int end_idx = (i == NUM_THREADS - 1) ? size : start_idx + chunk_size;
-    threads.emplace_back(randomVector, v1, start_idx, end_idx);
-  }
-
-  for (auto &t : threads) t.join();
-  threads.clear();
-
-  for (int i = 0; i < NUM_THREADS; i++) {
-    int start_idx = i * chunk_size;
-    int end_idx = (i == NUM_THREADS - 1) ? size : start_idx + chunk_size;
-    threads.emplace_back(randomVector, v2, start_idx, end_idx);
+  // Huge-page backed where the system allows (HUGEPAGES=off for ordinary pages)
+  HugePageKind pages;
+  int *v1, *v2, *v3;
+  v1 = hugepage_alloc_array<int>(size, &pages);
+  v2 = hugepage_alloc_array<int>(size);
+  v3 = hugepage_alloc_array<int>(size);
+  if (!v1 || !v2 || !v3) {
+    cerr << "Failed to allocate " << size << "-element vectors" << endl;
+    return 1;
   }
 
-  for (auto &t : threads) t.join();
-  threads.clear();
+  auto start = high_resolution_clock::now();
 
-  // Create threads to perform parallel vector addition
-  for (int i = 0; i < NUM_THREADS; i++) {
-    int start_idx = i * chunk_size;
-    int end_idx = (i == NUM_THREADS - 1) ? size : start_idx + chunk_size;
-    threads.emplace_back(vectorAdd, v1, v2, v3, start_idx, end_idx);
-  }
+  // Fill vectors in parallel with random numbers 0-99. Counter-based
+  // (counter_rng.h), so the data is the same for any thread count.
+  backend_random_fill(exec, v1, size, counter_rng_stream(seed, 0), 100);
+  backend_random_fill(exec, v2, size, counter_rng_stream(seed, 1), 100);
 
-  for (auto &t : threads) t.join();
+  // Parallel vector addition; v3 is not read again, so the sums go out with
+  // streaming stores (vector_ops.h)
+  auto add_start = high_resolution_clock::now();
+  backend_vector_add(exec, v1, v2, v3, size);
 
   auto stop = high_resolution_clock::now();
+  double add_seconds = std::chrono::duration<double>(stop - add_start).count();
   auto duration = duration_cast<microseconds>(stop - start);
 
   cout << "Time taken by parallel function: " << duration.count() << " microseconds" << endl;
+  cout << "Vector addition: " << (long)(add_seconds * 1e6) << " microseconds, "
+       << add_bandwidth_gbs(size, add_seconds) << " GB/s (" << hugepage_kind_name(pages) << ")" << endl;
 
-  free(v1);
-  free(v2);
-  free(v3);
+  hugepage_free_array(v1, size);
+  hugepage_free_array(v2, size);
+  hugepage_free_array(v3, size);
 
   return 0;
 }
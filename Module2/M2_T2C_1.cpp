@@ -3,47 +3,29 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include "backend.h"
+#include "counter_rng.h"
 
 using namespace std;
 using namespace std::chrono;
 
-int partition(vector<int>& vec, int low, int high) {
-    int pivot = vec[high];
-    int i = low - 1;
-
-    for (int j = low; j < high; ++j) {
-        if (vec[j] <= pivot) {
-            ++i;
-            swap(vec[i], vec[j]);
-        }
-    }
-    swap(vec[i + 1], vec[high]);
-    return i + 1;
-}
-
-void quickSort(vector<int>& vec, int low, int high) {
-    if (low < high) {
-        int pi = partition(vec, low, high);
-        quickSort(vec, low, pi - 1);
-        quickSort(vec, pi + 1, high);
-    }
-}
-
-int main() {
-    srand(time(0));
+int main(int argc, char** argv) {
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
+    // Serial unless --backend NAME or BACKEND picks another executor
+    // (backend.h); the serial backend is std::sort, the others a parallel
+    // sample sort
+    Executor exec(backend_select(argc, argv, BACKEND_SERIAL));
     int n;
     cout << "Enter number of elements: ";
     cin >> n;
 
     vector<int> vec(n);
-    for (int& num : vec) {
-        num = rand() % 1000;
-    }
+    counter_rng_fill(vec.data(), n, 0, seed, 1000);  // 0-999, see counter_rng.h
 
     auto start = high_resolution_clock::now();
-    quickSort(vec, 0, n - 1);
+    backend_sort(exec, vec.data(), vec.size());
     auto end = high_resolution_clock::now();
 
-    cout << "Execution Time: " << duration_cast<microseconds>(end - start).count();
+    cout << "Execution Time (" << backend_name(exec.backend()) << "): " << duration_cast<microseconds>(end - start).count();
     return 0;
 }
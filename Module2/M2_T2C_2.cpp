@@ -1,73 +1,79 @@
 #include <iostream>
 #include <vector>
-#include <pthread.h>
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include "backend.h"
+#include "counter_rng.h"
+#include "quicksort_partition.h"
+#include "ws_scheduler.h"
 
 using namespace std;
 using namespace std::chrono;
 
-struct Args {
-    vector<int>* vec;
-    int low;
-    int high;
-};
+// Smaller sides below this size are sorted by the worker that owns them
+// instead of being spawned (a task costs more than sorting a few thousand keys)
+const int SPAWN_CUTOFF = 4096;
 
-int partition(vector<int>& vec, int low, int high) {
-    int pivot = vec[high];
-    int i = low - 1;
+// Quicksort on the work-stealing scheduler (ws_scheduler.h). The smaller
+// side of each partition is spawned for an idle worker to steal while it is
+// at least SPAWN_CUTOFF keys, and sorted right here otherwise; the larger
+// side stays in this loop. However lopsided the pivots are, every worker
+// keeps finding pieces to sort and the recursion depth stays O(log n).
+void parallelQuickSort(vector<int>& vec, int low, int high, WsTaskGroup& group) {
+    while (high - low + 1 > INSERTION_CUTOFF) {
+        int lt, gt;
+        partition3(vec, low, high, choosePivot(vec, low, high), lt, gt);
 
-    for (int j = low; j < high; ++j) {
-        if (vec[j] <= pivot) {
-            ++i;
-            swap(vec[i], vec[j]);
+        int leftLow = low, leftHigh = lt - 1, rightLow = gt + 1, rightHigh = high;
+        if (leftHigh - leftLow > rightHigh - rightLow) {
+            swap(leftLow, rightLow);
+            swap(leftHigh, rightHigh);
         }
+        // [leftLow, leftHigh] is now the smaller side
+        if (leftHigh - leftLow + 1 >= SPAWN_CUTOFF)
+            group.spawn([&vec, &group, leftLow, leftHigh] { parallelQuickSort(vec, leftLow, leftHigh, group); });
+        else
+            parallelQuickSort(vec, leftLow, leftHigh, group);
+        low = rightLow;
+        high = rightHigh;
     }
-    swap(vec[i + 1], vec[high]);
-    return i + 1;
+    insertionSort(vec, low, high);
 }
 
-void quickSort(vector<int>& vec, int low, int high) {
-    if (low < high) {
-        int pi = partition(vec, low, high);
-        quickSort(vec, low, pi - 1);
-        quickSort(vec, pi + 1, high);
-    }
-}
-
-void* threadedQuickSort(void* arg) {
-    Args* args = (Args*)arg;
-    quickSort(*args->vec, args->low, args->high);
-    return nullptr;
-}
-
-int main() {
-    srand(time(0));
+int main(int argc, char** argv) {
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
+    // The shared sample sort (backend.h) runs on the same input for
+    // comparison, on a Pthreads pool unless --backend NAME or BACKEND says otherwise
+    Executor exec(backend_select(argc, argv, BACKEND_PTHREADS));
     int n;
     cout << "Enter number of elements: ";
     cin >> n;
 
     vector<int> vec(n);
-    for (int& num : vec) {
-        num = rand() % 1000;
-    }
+    counter_rng_fill(vec.data(), n, 0, seed, 1000);  // 0-999, see counter_rng.h
+    vector<int> sample = vec;
 
-    auto start = high_resolution_clock::now();
-
-    int pi = partition(vec, 0, n - 1);
-
-    Args left = { &vec, 0, pi - 1 };
-    Args right = { &vec, pi + 1, n - 1 };
+    // WS_THREADS=n picks the worker count (default: one per core)
+    WsScheduler scheduler;
 
-    pthread_t t1, t2;
-    pthread_create(&t1, nullptr, threadedQuickSort, &left);
-    pthread_create(&t2, nullptr, threadedQuickSort, &right);
+    auto start = high_resolution_clock::now();
+    scheduler.run([&] {
+        WsTaskGroup group;
+        parallelQuickSort(vec, 0, n - 1, group);
+        group.wait();
+    });
+    auto end = high_resolution_clock::now();
 
-    pthread_join(t1, nullptr);
-    pthread_join(t2, nullptr);
+    cout << "Execution Time: " << duration_cast<microseconds>(end - start).count() << endl;
+    cout << "Tasks per worker:";
+    for (int w = 0; w < scheduler.size(); w++) cout << " " << scheduler.tasks_run(w);
+    cout << endl;
 
-    auto end = high_resolution_clock::now();
-    cout << "Execution Time: " << duration_cast<microseconds>(end - start).count();
+    start = high_resolution_clock::now();
+    backend_sort(exec, sample.data(), sample.size());
+    end = high_resolution_clock::now();
+    cout << "Sample Sort (" << backend_name(exec.backend()) << ") Execution Time: "
+         << duration_cast<microseconds>(end - start).count() << (sample == vec ? "" : " (RESULTS DIFFER)") << endl;
     return 0;
 }
@@ -1,63 +1,132 @@
 #include <iostream>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
 #include <omp.h>
+#include "backend.h"
+#include "counter_rng.h"
+#include "quicksort_partition.h"
+#include "radix_sort.h"
 
 using namespace std;
 using namespace std::chrono;
 
-int partition(vector<int>& vec, int low, int high) {
-    int pivot = vec[high];
-    int i = low - 1;
+// Ranges below this size are sorted by the task that owns them rather than
+// split into new tasks (a task costs far more than sorting a few thousand keys)
+const int TASK_CUTOFF = 16384;
 
-    for (int j = low; j < high; ++j) {
-        if (vec[j] <= pivot) {
-            ++i;
-            swap(vec[i], vec[j]);
+// Fallback once a range has been split more than 2 log2(n) times: heapsort is
+// O(n log n) whatever the input, so no pivot sequence can make the sort quadratic
+void heapSort(vector<int>& vec, int low, int high) {
+    make_heap(vec.begin() + low, vec.begin() + high + 1);
+    sort_heap(vec.begin() + low, vec.begin() + high + 1);
+}
+
+// Task-parallel introsort. The smaller side of each partition becomes an
+// OpenMP task (while it is big enough to be worth one) and the larger side
+// is handled in this loop, so the task tree stays shallow and recursion
+// depth is O(log n). Must run inside a parallel region; the region's closing
+// barrier waits for every task.
+void parallelIntroSort(vector<int>& vec, int low, int high, int depthLimit) {
+    while (high - low + 1 > INSERTION_CUTOFF) {
+        if (depthLimit-- == 0) {
+            heapSort(vec, low, high);
+            return;
+        }
+        int lt, gt;
+        partition3(vec, low, high, choosePivot(vec, low, high), lt, gt);
+
+        int leftLow = low, leftHigh = lt - 1, rightLow = gt + 1, rightHigh = high;
+        if (leftHigh - leftLow > rightHigh - rightLow) {
+            swap(leftLow, rightLow);
+            swap(leftHigh, rightHigh);
+        }
+        // [leftLow, leftHigh] is now the smaller side
+        if (leftHigh - leftLow + 1 >= TASK_CUTOFF) {
+            #pragma omp task firstprivate(leftLow, leftHigh, depthLimit) shared(vec)
+            parallelIntroSort(vec, leftLow, leftHigh, depthLimit);
+        } else {
+            parallelIntroSort(vec, leftLow, leftHigh, depthLimit);
         }
+        low = rightLow;
+        high = rightHigh;
     }
-    swap(vec[i + 1], vec[high]);
-    return i + 1;
+    insertionSort(vec, low, high);
 }
 
-void parallelQuickSort(vector<int>& vec, int low, int high) {
-    if (low < high) {
-        int pi = partition(vec, low, high);
+void parallelSort(vector<int>& vec) {
+    int n = vec.size();
+    int depthLimit = 2;
+    for (int size = n; size > 1; size >>= 1) depthLimit += 2;  // 2 log2(n)
 
-        #pragma omp parallel sections
-        {
-            #pragma omp section
-            parallelQuickSort(vec, low, pi - 1);
-
-            #pragma omp section
-            parallelQuickSort(vec, pi + 1, high);
-        }
+    #pragma omp parallel
+    {
+        #pragma omp single nowait
+        parallelIntroSort(vec, 0, n - 1, depthLimit);
     }
 }
 
-int main() {
-    srand(time(0));
+// Test inputs: random (0-999, many duplicates), unique (0 .. 2^31-1),
+// sorted, reversed, organpipe (ascending then descending) and equal
+void fillInput(vector<int>& vec, const string& distribution, uint64_t seed) {
+    int n = vec.size();
+    if (distribution == "unique") counter_rng_fill(vec.data(), n, 0, seed, 0x7fffffff);
+    else if (distribution == "sorted") for (int i = 0; i < n; i++) vec[i] = i;
+    else if (distribution == "reversed") for (int i = 0; i < n; i++) vec[i] = n - i;
+    else if (distribution == "organpipe") for (int i = 0; i < n; i++) vec[i] = min(i, n - i);
+    else if (distribution == "equal") fill(vec.begin(), vec.end(), 7);
+    else counter_rng_fill(vec.data(), n, 0, seed, 1000);  // 0-999, see counter_rng.h
+}
+
+int main(int argc, char** argv) {
+    // Arguments: [distribution] [--backend NAME]. distribution is random,
+    // unique, sorted, reversed, organpipe or equal (default random); the
+    // backend runs the shared sample sort of backend.h for comparison
+    string distribution = "random";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--backend") == 0) i++;
+        else distribution = argv[i];
+    }
+    Executor exec(backend_select(argc, argv, BACKEND_OPENMP));
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
     int n;
     cout << "Enter number of elements: ";
     cin >> n;
 
     vector<int> vec(n);
-    for (int& num : vec) {
-        num = rand() % 1000;
-    }
+    fillInput(vec, distribution, seed);
+    vector<int> reference = vec, radix = vec, sample = vec;
 
     auto start = high_resolution_clock::now();
+    parallelSort(vec);
+    auto end = high_resolution_clock::now();
 
-    #pragma omp parallel
-    {
-        #pragma omp single
-        parallelQuickSort(vec, 0, n - 1);
-    }
+    // std::sort on the same input, for comparison and to check the result
+    auto refStart = high_resolution_clock::now();
+    sort(reference.begin(), reference.end());
+    auto refEnd = high_resolution_clock::now();
 
-    auto end = high_resolution_clock::now();
+    // Parallel LSD radix sort (radix_sort.h): no comparisons, a few passes over memory
+    auto radixStart = high_resolution_clock::now();
+    radix_sort(radix);
+    auto radixEnd = high_resolution_clock::now();
+
+    // Sample sort through the backend layer, on the chosen executor
+    auto sampleStart = high_resolution_clock::now();
+    backend_sort(exec, sample.data(), sample.size());
+    auto sampleEnd = high_resolution_clock::now();
 
-    cout << "Parallel Execution Time: " << duration_cast<microseconds>(end - start).count();
+    cout << "Parallel Execution Time: " << duration_cast<microseconds>(end - start).count() << endl;
+    cout << "std::sort Execution Time: " << duration_cast<microseconds>(refEnd - refStart).count()
+         << (vec == reference ? "" : " (RESULTS DIFFER)") << endl;
+    cout << "Radix Sort Execution Time: " << duration_cast<microseconds>(radixEnd - radixStart).count()
+         << (radix == reference ? "" : " (RESULTS DIFFER)") << endl;
+    cout << "Sample Sort (" << backend_name(exec.backend()) << ") Execution Time: "
+         << duration_cast<microseconds>(sampleEnd - sampleStart).count()
+         << (sample == reference ? "" : " (RESULTS DIFFER)") << endl;
     return 0;
 }
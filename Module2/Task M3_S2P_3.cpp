@@ -1,77 +1,113 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <chrono>
 #include <iostream>
+#include "vector_ops.h"
+#include "counter_rng.h"
+#include "row_distribution.h"
 
 using namespace std;
 using namespace std::chrono;
 
-void randomVector(int vector[], int size) {
-    for (int i = 0; i < size; i++) {
-        vector[i] = rand() % 100;
-    }
+// Random values 0-99 from the counter-based generator (counter_rng.h) for
+// elements first .. first + count - 1 of the vector, so a rank can make just
+// its own slice and get the same values rank 0 would have made
+void randomVector(int vector[], unsigned long count, unsigned long first, uint64_t seed) {
+    counter_rng_fill(vector, count, first, seed, 100);
 }
 
 int main(int argc, char* argv[]) {
     int rank, size;
     unsigned long total_size = 100000000;
-    srand(time(0));
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
 
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    int chunk_size = total_size / size;
-
-    int* v1 = nullptr;
-    int* v2 = nullptr;
-    int* v3 = (int*)malloc(chunk_size * sizeof(int));
-
-    if (rank == 0) {
-        // Allocate full vectors in master
-        v1 = (int*)malloc(total_size * sizeof(int));
-        v2 = (int*)malloc(total_size * sizeof(int));
-
-        randomVector(v1, total_size);
-        randomVector(v2, total_size);
+    // Arguments: [total_size] [--scatter] [--no-gather]
+    // By default every rank generates its own slice of v1 and v2 and rank 0
+    // holds no full input vector. --scatter restores the original flow (rank 0
+    // fills both vectors and scatters them); --no-gather skips collecting v3
+    // when only the sum is wanted.
+    bool scatter = false, gather = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scatter") == 0) scatter = true;
+        else if (strcmp(argv[i], "--no-gather") == 0) gather = false;
+        else total_size = strtoul(argv[i], NULL, 10);
+    }
+    if (total_size > (unsigned long)INT_MAX) {
+        if (rank == 0) cerr << "total_size must fit an MPI count (" << INT_MAX << ")" << endl;
+        MPI_Finalize();
+        return 1;
+    }
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);  // Rank 0's seed; clocks may differ
+
+    // Any total size: the total_size % size leftover elements go one each to
+    // the lowest ranks
+    RowDistribution dist = row_distribution_even((int)total_size, size, 1);
+    int local_size = dist.counts[rank];
+    unsigned long first = dist.displs[rank];
+
+    int* local1 = (int*)malloc(local_size * sizeof(int));
+    int* local2 = (int*)malloc(local_size * sizeof(int));
+    int* local3 = (int*)malloc(local_size * sizeof(int));
+    int* v3 = nullptr;
+
+    auto generate_start = high_resolution_clock::now();
+    auto start = generate_start;
+    if (scatter) {
+        int* v1 = nullptr;
+        int* v2 = nullptr;
+        if (rank == 0) {
+            // Allocate full vectors in master
+            v1 = (int*)malloc(total_size * sizeof(int));
+            v2 = (int*)malloc(total_size * sizeof(int));
+            randomVector(v1, total_size, 0, counter_rng_stream(seed, 0));
+            randomVector(v2, total_size, 0, counter_rng_stream(seed, 1));
+        }
+        start = high_resolution_clock::now();
+        MPI_Scatterv(v1, dist.counts.data(), dist.displs.data(), MPI_INT, local1, local_size, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Scatterv(v2, dist.counts.data(), dist.displs.data(), MPI_INT, local2, local_size, MPI_INT, 0, MPI_COMM_WORLD);
+        free(v1);
+        free(v2);
+    } else {
+        randomVector(local1, local_size, first, counter_rng_stream(seed, 0));
+        randomVector(local2, local_size, first, counter_rng_stream(seed, 1));
+        MPI_Barrier(MPI_COMM_WORLD);  // The timed part starts with every slice ready
+        start = high_resolution_clock::now();
     }
 
-    auto start = high_resolution_clock::now();
-
-    // Scatter v1 and v2 to all processes
-    MPI_Scatter(v1, chunk_size, MPI_INT, v1, chunk_size, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Scatter(v2, chunk_size, MPI_INT, v2, chunk_size, MPI_INT, 0, MPI_COMM_WORLD);
+    // Each process adds its part and sums it in the same pass
+    long long partial_sum = add_and_sum(local1, local2, local3, local_size);
 
-    // Each process computes its part of the addition
-    for (int i = 0; i < chunk_size; i++) {
-        v3[i] = v1[i] + v2[i];
+    // Gather results to master process
+    if (gather) {
+        if (rank == 0) v3 = (int*)malloc(total_size * sizeof(int));
+        MPI_Gatherv(local3, local_size, MPI_INT, v3, dist.counts.data(), dist.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
     }
 
-    // Gather results to master process
-    MPI_Gather(v3, chunk_size, MPI_INT, v3, chunk_size, MPI_INT, 0, MPI_COMM_WORLD);
+    // Total sum from the per-rank partial sums, not from the gathered vector
+    long long total_sum = 0;
+    MPI_Reduce(&partial_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
 
     auto stop = high_resolution_clock::now();
 
     if (rank == 0) {
+        cout << "Input generation (" << (scatter ? "rank 0" : "per rank") << "): "
+             << duration_cast<microseconds>(start - generate_start).count() << " microseconds" << endl;
         auto duration = duration_cast<microseconds>(stop - start);
-        cout << "Time taken by MPI vector addition: " << duration.count() << " microseconds" << endl;
-
-        // Total sum using MPI_Reduce
-        long long total_sum = 0;
-        long long partial_sum = 0;
-        for (unsigned long i = 0; i < total_size; i++) {
-            partial_sum += v3[i];
-        }
-
-        MPI_Reduce(&partial_sum, &total_sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-
+        cout << "Time taken by MPI vector addition" << (gather ? "" : " (no gather)") << ": " << duration.count()
+             << " microseconds" << endl;
         cout << "Total sum of v3 elements = " << total_sum << endl;
-
-        free(v1);
-        free(v2);
-        free(v3);
     }
+    free(v3);
+    free(local1);
+    free(local2);
+    free(local3);
 
     MPI_Finalize();
     return 0;
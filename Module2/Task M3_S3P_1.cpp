@@ -1,93 +1,130 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CL/cl.h>
 #include <chrono>
+#include <vector>
+#include "counter_rng.h"
+#include "hugepage_alloc.h"
 
 #define PRINT 1  
+#define STREAM_QUEUES 2           // Chunks alternate between this many queues
+#define STREAM_CHUNK (1 << 22)    // Default chunk in elements (16 MB per buffer)
 
 int SZ = 100000000; // Default size of the vectors
 
-// Host-side arrays
+// Host-side arrays (page-aligned, so a CPU device can use them in place)
 int *v1, *v2, *v_out;
 
-// OpenCL memory buffers (device-side)
+// OpenCL memory buffers (device-side) for the whole-vector and zero-copy runs
 cl_mem bufV1, bufV2, bufV_out;
 
-// OpenCL object handles
+// OpenCL object handles. Every queue has profiling enabled; the whole-vector
+// and zero-copy runs use queues[0] (`queue`).
 cl_device_id device_id;
 cl_context context;
 cl_program program;
 cl_kernel kernel;
-cl_command_queue queue;
-cl_event event = NULL;
+cl_command_queue queues[STREAM_QUEUES];
+cl_command_queue &queue = queues[0];
 
 int err;
 
+// Device time per phase, summed over the profiled commands
+struct PhaseTimes {
+    double upload = 0, kernel = 0, download = 0;
+};
+
 // Function declarations
 cl_device_id create_device();
 void setup_openCL_device_context_queue_kernel(char *filename, char *kernelname);
 cl_program build_program(cl_context ctx, cl_device_id dev, const char *filename);
-void setup_kernel_memory();
-void copy_kernel_args();
+bool device_shares_host_memory();
+void setup_kernel_memory(bool zero_copy);
+void set_kernel_args(int size, cl_mem in1, cl_mem in2, cl_mem out);
+PhaseTimes run_whole();
+PhaseTimes run_zero_copy();
+PhaseTimes run_streaming(int chunk);
+double event_ms(cl_event event);
 void free_memory();
-void init(int *&A, int size);
+void init(int *&A, int size, uint64_t seed);
 void print(int *A, int size);
 
 int main(int argc, char **argv) {
-    // If vector size is given as a command line argument, use it
-    if (argc > 1) {
-        SZ = atoi(argv[1]); 
+    // Arguments: [size] [--stream] [--chunk elements]
+    // --stream pushes the vectors through fixed-size chunks instead of three
+    // size-length device buffers; it is chosen automatically when the vectors
+    // do not fit the device. CPU devices work on the host arrays in place.
+    bool stream = false;
+    int chunk = STREAM_CHUNK;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) stream = true;
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) chunk = atoi(argv[++i]);
+        else SZ = atoi(argv[i]);
     }
 
     // Allocate and initialize the host vectors with random values
-    init(v1, SZ);
-    init(v2, SZ);
-    init(v_out, SZ); 
-
-    size_t global[1] = {(size_t)SZ}; // Total number of work-items
+    uint64_t seed = counter_rng_seed(1);  // RNG_SEED=n picks other inputs
+    init(v1, SZ, counter_rng_stream(seed, 0));
+    init(v2, SZ, counter_rng_stream(seed, 1));
+    init(v_out, SZ, counter_rng_stream(seed, 2)); 
 
     // Show initialized data (partial if large)
     print(v1, SZ);
     print(v2, SZ);
    
-    // Initialize OpenCL context, device, command queue, and compile the kernel
+    // Initialize OpenCL context, device, command queues, and compile the kernel
     setup_openCL_device_context_queue_kernel((char *)"./vector_ops_ocl.cl", (char *)"vector_add_ocl");
-    
-    // Allocate device memory and copy data to device
-    setup_kernel_memory();
-    
-    // Set arguments for the kernel function
-    copy_kernel_args();
-
-    // Start timing the kernel execution
-    auto start = std::chrono::high_resolution_clock::now();
-
-    // Run the kernel function on the device
-    clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global, NULL, 0, NULL, &event);
-    clWaitForEvents(1, &event);
 
-    // Copy the result back from device to host
-    clEnqueueReadBuffer(queue, bufV_out, CL_TRUE, 0, SZ * sizeof(int), &v_out[0], 0, NULL, NULL);
+    bool zero_copy = device_shares_host_memory();
+    cl_ulong globalMem = 0, maxAlloc = 0;
+    clGetDeviceInfo(device_id, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(globalMem), &globalMem, NULL);
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAlloc), &maxAlloc, NULL);
+    size_t bytes = (size_t)SZ * sizeof(int);
+    if (!zero_copy && (3 * bytes > globalMem || bytes > maxAlloc)) stream = true;
+    if (chunk > SZ) chunk = SZ;
+    if ((size_t)chunk * sizeof(int) > maxAlloc) chunk = maxAlloc / sizeof(int);
+    if ((size_t)chunk * sizeof(int) * 3 * STREAM_QUEUES > globalMem) chunk = globalMem / (sizeof(int) * 3 * STREAM_QUEUES);
+
+    // Time only the transfers and the kernel (not setup or printing)
+    auto start = std::chrono::high_resolution_clock::now();
+    PhaseTimes phases;
+    const char *mode;
+    if (zero_copy) {
+        mode = "zero-copy";
+        phases = run_zero_copy();
+    } else if (stream && chunk > 0) {
+        mode = "streaming";
+        phases = run_streaming(chunk);
+    } else {
+        mode = "whole vectors";
+        phases = run_whole();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed_time = stop - start;
 
     // Display result (partial if large)
     print(v_out, SZ);
 
-    // Stop timing
-    auto stop = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> elapsed_time = stop - start;
-
-    printf("Kernel Execution Time: %f ms\n", elapsed_time.count());
+    printf("Mode: %s", mode);
+    if (!zero_copy && stream) printf(" (%d queues, %d-element chunks)", STREAM_QUEUES, chunk);
+    printf("\nUpload Time: %f ms\n", phases.upload);
+    printf("Kernel Execution Time: %f ms\n", phases.kernel);
+    printf("Download Time: %f ms\n", phases.download);
+    printf("Total Time: %f ms (phases overlap when this is below their sum)\n", elapsed_time.count());
 
     // Clean up allocated resources
     free_memory();
 }
 
-// Initialize a vector with random numbers from 0 to 99
-void init(int *&A, int size) {
-    A = (int *)malloc(sizeof(int) * size);
-    for (long i = 0; i < size; i++) {
-        A[i] = rand() % 100; 
+// Initialize a vector with random numbers from 0 to 99 (counter-based, see counter_rng.h)
+void init(int *&A, int size, uint64_t seed) {
+    A = hugepage_alloc_array<int>(size);
+    if (A == NULL) {
+        fprintf(stderr, "Couldn't allocate a %d-element vector\n", size);
+        exit(1);
     }
+    counter_rng_fill(A, size, 0, seed, 100);
 }
 
 // Display the contents of a vector
@@ -108,24 +145,25 @@ void print(int *A, int size) {
 
 // Release OpenCL and host memory
 void free_memory() {
-    clReleaseMemObject(bufV1);
-    clReleaseMemObject(bufV2);
-    clReleaseMemObject(bufV_out);
+    if (bufV1) clReleaseMemObject(bufV1);
+    if (bufV2) clReleaseMemObject(bufV2);
+    if (bufV_out) clReleaseMemObject(bufV_out);
     clReleaseKernel(kernel);
-    clReleaseCommandQueue(queue);
+    for (cl_command_queue q : queues) clReleaseCommandQueue(q);
     clReleaseProgram(program);
     clReleaseContext(context);
-    free(v1);
-    free(v2);
-    free(v_out); 
+    hugepage_free_array(v1, SZ);
+    hugepage_free_array(v2, SZ);
+    hugepage_free_array(v_out, SZ);
 }
 
-// Provide kernel function with necessary inputs and parameters
-void copy_kernel_args() {
-    clSetKernelArg(kernel, 0, sizeof(int), (void *)&SZ);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&bufV1);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&bufV2);
-    clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&bufV_out);
+// Provide kernel function with necessary inputs and parameters. Arguments are
+// captured at enqueue time, so one kernel object serves every chunk.
+void set_kernel_args(int size, cl_mem in1, cl_mem in2, cl_mem out) {
+    err = clSetKernelArg(kernel, 0, sizeof(int), (void *)&size);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&in1);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&in2);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&out);
 
     if (err < 0) {
         perror("Couldn't set a kernel argument");
@@ -134,17 +172,133 @@ void copy_kernel_args() {
     }
 }
 
-// Allocate buffers on the device and send input data over
-void setup_kernel_memory() {
-    bufV1 = clCreateBuffer(context, CL_MEM_READ_WRITE, SZ * sizeof(int), NULL, NULL);
-    bufV2 = clCreateBuffer(context, CL_MEM_READ_WRITE, SZ * sizeof(int), NULL, NULL);
-    bufV_out = clCreateBuffer(context, CL_MEM_READ_WRITE, SZ * sizeof(int), NULL, NULL);
+// True when the device works in host memory (CPU devices, integrated GPUs),
+// where copying to "device" buffers only duplicates the data
+bool device_shares_host_memory() {
+    cl_device_type type = 0;
+    cl_bool unified = CL_FALSE;
+    clGetDeviceInfo(device_id, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+    clGetDeviceInfo(device_id, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+    return (type & CL_DEVICE_TYPE_CPU) || unified;
+}
 
-    clEnqueueWriteBuffer(queue, bufV1, CL_TRUE, 0, SZ * sizeof(int), &v1[0], 0, NULL, NULL);
-    clEnqueueWriteBuffer(queue, bufV2, CL_TRUE, 0, SZ * sizeof(int), &v2[0], 0, NULL, NULL);
+// Allocate the size-length buffers. Zero-copy buffers wrap the host arrays
+// (CL_MEM_USE_HOST_PTR; they are page-aligned as drivers require), the
+// others are plain device buffers filled by run_whole.
+void setup_kernel_memory(bool zero_copy) {
+    size_t bytes = (size_t)SZ * sizeof(int);
+    cl_mem_flags host = zero_copy ? CL_MEM_USE_HOST_PTR : 0;
+    cl_int errs[3];
+    bufV1 = clCreateBuffer(context, CL_MEM_READ_ONLY | host, bytes, zero_copy ? v1 : NULL, &errs[0]);
+    bufV2 = clCreateBuffer(context, CL_MEM_READ_ONLY | host, bytes, zero_copy ? v2 : NULL, &errs[1]);
+    bufV_out = clCreateBuffer(context, CL_MEM_WRITE_ONLY | host, bytes, zero_copy ? v_out : NULL, &errs[2]);
+    if (errs[0] < 0 || errs[1] < 0 || errs[2] < 0) {
+        perror("Couldn't create a buffer");
+        exit(1);
+    }
 }
 
-// Set up OpenCL context, command queue, and compile the kernel program
+// Device time of a finished command, from the queue's profiling counters
+double event_ms(cl_event event) {
+    cl_ulong begin = 0, end = 0;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(begin), &begin, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    clReleaseEvent(event);
+    return (end - begin) * 1e-6;
+}
+
+// Original flow: copy both vectors in, one kernel over everything, copy out
+PhaseTimes run_whole() {
+    size_t bytes = (size_t)SZ * sizeof(int);
+    size_t global[1] = {(size_t)SZ}; // Total number of work-items
+    cl_event up[2], run, down;
+    setup_kernel_memory(false);
+    clEnqueueWriteBuffer(queue, bufV1, CL_FALSE, 0, bytes, &v1[0], 0, NULL, &up[0]);
+    clEnqueueWriteBuffer(queue, bufV2, CL_FALSE, 0, bytes, &v2[0], 0, NULL, &up[1]);
+    set_kernel_args(SZ, bufV1, bufV2, bufV_out);
+    clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global, NULL, 0, NULL, &run);
+    clEnqueueReadBuffer(queue, bufV_out, CL_TRUE, 0, bytes, &v_out[0], 0, NULL, &down);
+
+    PhaseTimes t;
+    t.upload = event_ms(up[0]) + event_ms(up[1]);
+    t.kernel = event_ms(run);
+    t.download = event_ms(down);
+    return t;
+}
+
+// CPU-side device: the kernel reads and writes the host arrays directly and
+// the result is made visible to the host with a map instead of a copy
+PhaseTimes run_zero_copy() {
+    size_t bytes = (size_t)SZ * sizeof(int);
+    size_t global[1] = {(size_t)SZ};
+    cl_event run, map;
+    setup_kernel_memory(true);
+    set_kernel_args(SZ, bufV1, bufV2, bufV_out);
+    clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global, NULL, 0, NULL, &run);
+    void *mapped = clEnqueueMapBuffer(queue, bufV_out, CL_TRUE, CL_MAP_READ, 0, bytes, 0, NULL, &map, &err);
+    if (err < 0) {
+        perror("Couldn't map the result buffer");
+        exit(1);
+    }
+    clEnqueueUnmapMemObject(queue, bufV_out, mapped, 0, NULL, NULL);
+    clFinish(queue);
+
+    PhaseTimes t;
+    t.kernel = event_ms(run);
+    t.download = event_ms(map);
+    return t;
+}
+
+// Vectors of any length through fixed-size chunks. Chunk c goes to queue
+// c % STREAM_QUEUES with that queue's own buffer set, and each queue runs
+// upload, kernel, download in order for its chunks. While one queue computes
+// chunk i, the other downloads chunk i - 1 and uploads chunk i + 1, and a
+// buffer set is only reused once its queue has finished with it.
+PhaseTimes run_streaming(int chunk) {
+    size_t chunkBytes = (size_t)chunk * sizeof(int);
+    cl_mem sets[STREAM_QUEUES][3];
+    for (auto &set : sets) {
+        cl_int errs[3];
+        set[0] = clCreateBuffer(context, CL_MEM_READ_ONLY, chunkBytes, NULL, &errs[0]);
+        set[1] = clCreateBuffer(context, CL_MEM_READ_ONLY, chunkBytes, NULL, &errs[1]);
+        set[2] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, chunkBytes, NULL, &errs[2]);
+        if (errs[0] < 0 || errs[1] < 0 || errs[2] < 0) {
+            perror("Couldn't create a chunk buffer");
+            exit(1);
+        }
+    }
+
+    std::vector<cl_event> uploads, kernels, downloads;
+    for (int offset = 0, c = 0; offset < SZ; offset += chunk, c++) {
+        int count = SZ - offset < chunk ? SZ - offset : chunk;
+        size_t bytes = (size_t)count * sizeof(int), global[1] = {(size_t)count};
+        cl_command_queue q = queues[c % STREAM_QUEUES];
+        cl_mem *set = sets[c % STREAM_QUEUES];
+        cl_event up[2], run, down;
+
+        clEnqueueWriteBuffer(q, set[0], CL_FALSE, 0, bytes, v1 + offset, 0, NULL, &up[0]);
+        clEnqueueWriteBuffer(q, set[1], CL_FALSE, 0, bytes, v2 + offset, 0, NULL, &up[1]);
+        set_kernel_args(count, set[0], set[1], set[2]);
+        clEnqueueNDRangeKernel(q, kernel, 1, NULL, global, NULL, 0, NULL, &run);
+        clEnqueueReadBuffer(q, set[2], CL_FALSE, 0, bytes, v_out + offset, 0, NULL, &down);
+        clFlush(q);  // Start this chunk now rather than at the next blocking call
+
+        uploads.insert(uploads.end(), up, up + 2);
+        kernels.push_back(run);
+        downloads.push_back(down);
+    }
+    for (cl_command_queue q : queues) clFinish(q);
+
+    PhaseTimes t;
+    for (cl_event e : uploads) t.upload += event_ms(e);
+    for (cl_event e : kernels) t.kernel += event_ms(e);
+    for (cl_event e : downloads) t.download += event_ms(e);
+    for (auto &set : sets)
+        for (cl_mem buf : set) clReleaseMemObject(buf);
+    return t;
+}
+
+// Set up OpenCL context, command queues, and compile the kernel program
 void setup_openCL_device_context_queue_kernel(char *filename, char *kernelname) {
     device_id = create_device();
     cl_int err;
@@ -159,11 +313,14 @@ void setup_openCL_device_context_queue_kernel(char *filename, char *kernelname)
     // Load and build the OpenCL program (kernel)
     program = build_program(context, device_id, filename);
 
-    // Create a command queue to communicate with the device
-    queue = clCreateCommandQueueWithProperties(context, device_id, 0, &err);
-    if (err < 0) {
-        perror("Couldn't create a command queue");
-        exit(1);
+    // Create the command queues, with profiling for the per-phase times
+    cl_queue_properties properties[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
+    for (cl_command_queue &q : queues) {
+        q = clCreateCommandQueueWithProperties(context, device_id, properties, &err);
+        if (err < 0) {
+            perror("Couldn't create a command queue");
+            exit(1);
+        }
     }
 
     // Create a kernel object from the compiled program
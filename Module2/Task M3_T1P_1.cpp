@@ -1,18 +1,159 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <vector>
 #include <mpi.h>
+#include "matrix.h"
+#include "summa.h"
+#include "row_distribution.h"
+#include "mpi_pipeline.h"
+#include "gemm_narrow.h"
+#include "matrix_io_mpi.h"
+#include "sparse_mpi.h"
+#include "counter_rng.h"
 
 #define MATRIX_SIZE 100
 
-int matrixA[MATRIX_SIZE][MATRIX_SIZE], matrixB[MATRIX_SIZE][MATRIX_SIZE], resultMatrix[MATRIX_SIZE][MATRIX_SIZE];
+// Row-major N x N heap buffers; matrixA and resultMatrix are only allocated on rank 0
+std::vector<int> matrixA, matrixB, resultMatrix;
 
-void initialize_matrices() {
-    for (int row = 0; row < MATRIX_SIZE; row++)
-        for (int col = 0; col < MATRIX_SIZE; col++) {
-            matrixA[row][col] = rand() % 10;
-            matrixB[row][col] = rand() % 10;
+// Random 0..9 entries from the counter-based generator (counter_rng.h);
+// with density below 1.0 each entry is nonzero with that probability
+void initialize_matrices(uint64_t seed, double density) {
+    uint64_t seedA = counter_rng_stream(seed, 0), seedB = counter_rng_stream(seed, 1);
+    if (density >= 1.0) {
+        counter_rng_fill(matrixA.data(), matrixA.size(), 0, seedA, 10);
+        counter_rng_fill(matrixB.data(), matrixB.size(), 0, seedB, 10);
+        return;
+    }
+    for (size_t i = 0; i < matrixA.size(); i++) {
+        matrixA[i] = sparse_random_entry(seedA, i, density);
+        matrixB[i] = sparse_random_entry(seedB, i, density);
+    }
+}
+
+// Value in 0..9 of element (row, col) of matrix `which` (0 is A, 1 is B)
+// from the counter-based generator (counter_rng.h), so every rank can
+// generate its own blocks without rank 0 holding the matrices
+int element_value(uint64_t seed, int which, int n, int row, int col) {
+    return (int)counter_rng_below(counter_rng_stream(seed, which), (uint64_t)row * n + col, 10);
+}
+
+// SUMMA mode: `Task M3_T1P_1 --summa [N]` on a perfect-square number of ranks.
+// Each rank only ever holds its N/sqrt(P) x N/sqrt(P) blocks of A, B and C.
+int run_summa(int n, int currentRank) {
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);  // Rank 0's seed; clocks may differ
+
+    SummaGrid grid;
+    if (!summa_grid_create(MPI_COMM_WORLD, n, grid)) {
+        if (currentRank == 0) std::cerr << "SUMMA needs a perfect-square number of processes\n";
+        return 1;
+    }
+
+    int rows = summa_local_rows(grid), cols = summa_local_cols(grid);
+    int rowBegin = summa_block_begin(n, grid.q, grid.row), colBegin = summa_block_begin(n, grid.q, grid.col);
+    std::vector<int> blockA((size_t)rows * cols), blockB((size_t)rows * cols), blockC((size_t)rows * cols);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++) {
+            blockA[(size_t)i * cols + j] = element_value(seed, 0, n, rowBegin + i, colBegin + j);
+            blockB[(size_t)i * cols + j] = element_value(seed, 1, n, rowBegin + i, colBegin + j);
         }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    summa_multiply(grid, blockA.data(), blockB.data(), blockC.data());
+    double end = MPI_Wtime();
+
+    // Spot-check a few entries of every block with an O(N) dot product
+    int errors = 0;
+    for (int s = 0; s < 4 && rows > 0 && cols > 0; s++) {
+        int i = (s * 7919) % rows, j = (s * 104729) % cols;
+        long long expected = 0;
+        for (int k = 0; k < n; k++)
+            expected += element_value(seed, 0, n, rowBegin + i, k) * element_value(seed, 1, n, k, colBegin + j);
+        if (expected != blockC[(size_t)i * cols + j]) errors++;
+    }
+    int totalErrors = 0;
+    MPI_Reduce(&errors, &totalErrors, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    double elapsed = end - start, slowest = 0;
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (currentRank == 0) {
+        std::cout << "SUMMA " << grid.q << "x" << grid.q << " grid, N = " << n << ": " << slowest << " seconds, "
+                  << (totalErrors == 0 ? "spot checks passed" : "SPOT CHECK FAILURES") << "\n";
+    }
+    summa_grid_free(grid);
+    return totalErrors == 0 ? 0 : 2;
+}
+
+// File mode: `Task M3_T1P_1 --input A.bin B.bin [--output C.bin]` with any
+// compatible sizes. Every rank reads its own rows of A and all of B with
+// MPI-IO and writes its rows of C back the same way, so no matrix passes
+// through rank 0.
+int run_from_files(const char* inputA, const char* inputB, const char* output, int currentRank, int totalProcesses) {
+    MatrixHeader headerA, headerB;
+    if (!matrix_read_header_mpi<int>(inputA, headerA, MPI_COMM_WORLD) ||
+        !matrix_read_header_mpi<int>(inputB, headerB, MPI_COMM_WORLD)) {
+        if (currentRank == 0) std::cerr << "Inputs must be int32 matrix files\n";
+        return 1;
+    }
+    if (headerA.cols != headerB.rows) {
+        if (currentRank == 0) std::cerr << "Cannot multiply " << headerA.rows << " x " << headerA.cols << " by "
+                                        << headerB.rows << " x " << headerB.cols << "\n";
+        return 1;
+    }
+    int n = (int)headerA.rows, k = (int)headerA.cols, m = (int)headerB.cols;
+    RowDistribution rows = row_distribution_even(n, totalProcesses, 1);
+    int localRows = rows.rows(currentRank), firstRow = rows.first_row(currentRank);
+    std::vector<int> partialA((size_t)localRows * k), fullB((size_t)k * m), partialC((size_t)localRows * m);
+
+    double readStart = MPI_Wtime();
+    bool ok = matrix_read_rows_mpi(inputA, firstRow, localRows, partialA.data(), MPI_COMM_WORLD) &&
+              matrix_read_rows_mpi(inputB, 0, k, fullB.data(), MPI_COMM_WORLD);
+    double computationStart = MPI_Wtime();
+    gemm_blocked(localRows, m, k, partialA.data(), k, fullB.data(), m, partialC.data(), m);
+    double computationEnd = MPI_Wtime();
+    if (output)
+        ok = matrix_write_rows_mpi(output, n, m, firstRow, localRows, partialC.data(), MPI_COMM_WORLD) && ok;
+    double writeEnd = MPI_Wtime();
+
+    if (currentRank == 0) {
+        std::cout << "File mode " << n << " x " << k << " by " << k << " x " << m << ": read "
+                  << (computationStart - readStart) << " s, compute " << (computationEnd - computationStart)
+                  << " s, write " << (writeEnd - computationEnd) << " s" << (ok ? "" : "  (I/O ERRORS)") << "\n";
+    }
+    return ok ? 0 : 1;
+}
+
+// Row-distributed multiply with In-typed inputs: B and the rows of A travel
+// as `type` (a quarter of the int32 volume for int8), results accumulate in
+// int. Returns the local compute time.
+template <typename In>
+double multiply_narrow(const RowDistribution& rows, MPI_Datatype type, int currentRank) {
+    const size_t elements = (size_t)MATRIX_SIZE * MATRIX_SIZE;
+    std::vector<In> narrowA, narrowB(elements);
+    if (currentRank == 0) {
+        narrowA = narrow_copy<In>(matrixA.data(), elements);
+        narrowB = narrow_copy<In>(matrixB.data(), elements);
+    }
+    int localRows = rows.rows(currentRank);
+    std::vector<In> partialA(localRows * MATRIX_SIZE);
+    std::vector<int> partialC(localRows * MATRIX_SIZE);
+
+    MPI_Bcast(narrowB.data(), (int)elements, type, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(narrowA.data(), rows.counts.data(), rows.displs.data(), type,
+                 partialA.data(), rows.counts[currentRank], type, 0, MPI_COMM_WORLD);
+
+    double computationStart = MPI_Wtime();
+    gemm_narrow(localRows, MATRIX_SIZE, MATRIX_SIZE, partialA.data(), MATRIX_SIZE,
+                narrowB.data(), MATRIX_SIZE, partialC.data(), MATRIX_SIZE);
+    double computationEnd = MPI_Wtime();
+
+    MPI_Gatherv(partialC.data(), rows.counts[currentRank], MPI_INT,
+                resultMatrix.data(), rows.counts.data(), rows.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
+    return computationEnd - computationStart;
 }
 
 int main(int argc, char** argv) {
@@ -21,31 +162,133 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &currentRank);
     MPI_Comm_size(MPI_COMM_WORLD, &totalProcesses);
 
-    int rowsPerProcess = MATRIX_SIZE / totalProcesses;
-    int partialA[rowsPerProcess][MATRIX_SIZE], partialC[rowsPerProcess][MATRIX_SIZE];
+    if (argc > 1 && strcmp(argv[1], "--summa") == 0) {
+        int status = run_summa(argc > 2 ? atoi(argv[2]) : MATRIX_SIZE, currentRank);
+        MPI_Finalize();
+        return status;
+    }
+
+    const char *inputA = NULL, *inputB = NULL, *output = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--input") == 0 && i + 2 < argc) {
+            inputA = argv[++i];
+            inputB = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        }
+    }
+    if (inputA) {
+        int status = run_from_files(inputA, inputB, output, currentRank, totalProcesses);
+        MPI_Finalize();
+        return status;
+    }
+
+    // --weighted: size each rank's share by its measured speed
+    // --pipelined [panels]: overlap scatter/gather of row panels with compute
+    // --density d: fraction of nonzero inputs; sparse inputs switch to CSR
+    // --int32: ship int32 inputs even when a narrower type would hold them
+    bool weighted = false, pipelined = false, forceInt32 = false;
+    int panels = 4;
+    double density = 1.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--weighted") == 0) weighted = true;
+        else if (strcmp(argv[i], "--int32") == 0) forceInt32 = true;
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) density = atof(argv[++i]);
+        else if (strcmp(argv[i], "--pipelined") == 0) {
+            pipelined = true;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) panels = atoi(argv[++i]);
+        }
+    }
+
+    matrixB.resize(MATRIX_SIZE * MATRIX_SIZE);
+
+    RowDistribution rows = row_distribution_even(MATRIX_SIZE, totalProcesses, MATRIX_SIZE);
+    if (weighted) {
+        int sampleRows = std::min(16, MATRIX_SIZE);
+        std::vector<int> sampleA(sampleRows * MATRIX_SIZE), sampleC(sampleRows * MATRIX_SIZE);
+        double speed = measure_rows_per_second(sampleRows, [&](int r) {
+            gemm_blocked(r, MATRIX_SIZE, MATRIX_SIZE, sampleA.data(), MATRIX_SIZE,
+                         matrixB.data(), MATRIX_SIZE, sampleC.data(), MATRIX_SIZE);
+        });
+        rows = row_distribution_measured(MATRIX_SIZE, MATRIX_SIZE, speed, MPI_COMM_WORLD);
+    }
+    int localRows = rows.rows(currentRank);
+    std::vector<int> partialA(localRows * MATRIX_SIZE), partialC(localRows * MATRIX_SIZE);
 
     if (currentRank == 0) {
-        srand(time(NULL));
-        initialize_matrices();
+        matrixA.resize(MATRIX_SIZE * MATRIX_SIZE);
+        resultMatrix.resize(MATRIX_SIZE * MATRIX_SIZE);
+        initialize_matrices(counter_rng_seed(), density);  // RNG_SEED=n for repeatable inputs
     }
 
-    MPI_Bcast(matrixB, MATRIX_SIZE * MATRIX_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Scatter(matrixA, rowsPerProcess * MATRIX_SIZE, MPI_INT, partialA, rowsPerProcess * MATRIX_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+    // Sparse inputs go through CSR (sparse_mpi.h): only nonzeros travel
+    if (sparse_mpi_route(matrixA.data(), matrixB.data(), MATRIX_SIZE, MPI_COMM_WORLD)) {
+        SparseMpiTimes times = sparse_mpi_multiply(matrixA.data(), matrixB.data(), resultMatrix.data(), MATRIX_SIZE,
+                                                   MPI_INT, MPI_COMM_WORLD);
+        if (currentRank == 0) {
+            std::cout << "Sparse MPI (CSR, nnz A " << times.nnzA << ", B " << times.nnzB << ", C " << times.nnzC
+                      << "): " << times.total << " seconds end to end, " << times.compute << " compute on rank 0\n";
+            if (MATRIX_SIZE <= SPARSE_CHECK_MAX &&
+                !sparse_matches_dense(matrixA.data(), matrixB.data(), resultMatrix.data(), MATRIX_SIZE))
+                std::cout << "Sparse result differs from the dense product\n";
+        }
+        MPI_Finalize();
+        return 0;
+    }
 
-    double computationStart = MPI_Wtime();
+    if (pipelined) {
+        PipelineTimes times = pipelined_multiply(
+            matrixA.data(), matrixB.data(), resultMatrix.data(), MATRIX_SIZE, rows,
+            partialA.data(), partialC.data(), panels, GEMM_MC,
+            [](const int* A, int* C, int r) {
+                memset(C, 0, sizeof(int) * r * MATRIX_SIZE);
+                gemm_blocked(r, MATRIX_SIZE, MATRIX_SIZE, A, MATRIX_SIZE, matrixB.data(), MATRIX_SIZE, C, MATRIX_SIZE);
+            },
+            MPI_COMM_WORLD);
+        if (currentRank == 0) {
+            std::cout << "Pipelined MPI (" << panels << " panels): " << times.total << " seconds end to end, "
+                      << times.compute << " compute, " << times.comm_wait << " waiting on communication\n";
+        }
+        MPI_Finalize();
+        return 0;
+    }
 
-    for (int i = 0; i < rowsPerProcess; i++) {
-        for (int j = 0; j < MATRIX_SIZE; j++) {
-            partialC[i][j] = 0;
-            for (int k = 0; k < MATRIX_SIZE; k++) {
-                partialC[i][j] += partialA[i][k] * matrixB[k][j];
-            }
+    // Ship and multiply the inputs in the narrowest type that holds them exactly
+    int narrow = NARROW_INT32;
+    if (currentRank == 0) {
+        size_t elements = (size_t)MATRIX_SIZE * MATRIX_SIZE;
+        narrow = gemm_narrow_type(matrixA.data(), elements, matrixB.data(), elements, MATRIX_SIZE);
+    }
+    MPI_Bcast(&narrow, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (narrow == NARROW_OVERFLOW) {
+        if (currentRank == 0) std::cerr << "Inputs are too large: products can overflow an int32 accumulator\n";
+        MPI_Finalize();
+        return 1;
+    }
+    if (narrow != NARROW_INT32 && !forceInt32) {
+        double elapsed = narrow == NARROW_INT8 ? multiply_narrow<int8_t>(rows, MPI_INT8_T, currentRank)
+                                               : multiply_narrow<int16_t>(rows, MPI_INT16_T, currentRank);
+        if (currentRank == 0) {
+            std::cout << "Parallel execution time using MPI (" << narrow_type_name((NarrowType)narrow)
+                      << " inputs): " << elapsed << " seconds\n";
         }
+        MPI_Finalize();
+        return 0;
     }
 
+    MPI_Bcast(matrixB.data(), MATRIX_SIZE * MATRIX_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(matrixA.data(), rows.counts.data(), rows.displs.data(), MPI_INT,
+                 partialA.data(), rows.counts[currentRank], MPI_INT, 0, MPI_COMM_WORLD);
+
+    double computationStart = MPI_Wtime();
+
+    gemm_blocked(localRows, MATRIX_SIZE, MATRIX_SIZE, partialA.data(), MATRIX_SIZE,
+                 matrixB.data(), MATRIX_SIZE, partialC.data(), MATRIX_SIZE);
+
     double computationEnd = MPI_Wtime();
 
-    MPI_Gather(partialC, rowsPerProcess * MATRIX_SIZE, MPI_INT, resultMatrix, rowsPerProcess * MATRIX_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(partialC.data(), rows.counts[currentRank], MPI_INT,
+                resultMatrix.data(), rows.counts.data(), rows.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
 
     if (currentRank == 0) {
         std::cout << "Parallel execution time using MPI: " << (computationEnd - computationStart) << " seconds\n";
@@ -1,21 +1,47 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <vector>
 #include <mpi.h>
 #include <omp.h>
+#include "matrix.h"
+#include "row_distribution.h"
+#include "mpi_pipeline.h"
+#include "sparse_mpi.h"
+#include "gemm_fixed.h"
+#include "counter_rng.h"
 
 #define N 100
 
-int matrixA[N][N], matrixB[N][N], resultMatrix[N][N];
-int localMatrixA[N][N], localMatrixC[N][N];
+// Row-major heap buffers; matrixA and resultMatrix are only allocated on rank 0
+std::vector<int> matrixA, matrixB, resultMatrix;
+std::vector<int> localMatrixA, localMatrixC;
 
-// Function to randomly initialize matrixA and matrixB
-void initialize_matrices() {
-    for (int i = 0; i < N; i++)
-        for (int j = 0; j < N; j++) {
-            matrixA[i][j] = rand() % 10;
-            matrixB[i][j] = rand() % 10;
-        }
+// Function to randomly initialize matrixA and matrixB from the counter-based
+// generator (counter_rng.h); density 1.0 keeps the original 0..9 fill
+void initialize_matrices(uint64_t seed, double density) {
+    uint64_t seedA = counter_rng_stream(seed, 0), seedB = counter_rng_stream(seed, 1);
+    if (density >= 1.0) {
+        counter_rng_fill(matrixA.data(), (size_t)N * N, 0, seedA, 10);
+        counter_rng_fill(matrixB.data(), (size_t)N * N, 0, seedB, 10);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)N * N; i++) {
+        matrixA[i] = sparse_random_entry(seedA, i, density);
+        matrixB[i] = sparse_random_entry(seedB, i, density);
+    }
+}
+
+// C = A * matrixB for `rows` rows using OpenMP parallel loops, one row block
+// per iteration, through gemm_dispatch (the N x N fixed-size kernel when N
+// is one of GemmFixedSquareSizes, gemm_blocked otherwise)
+void multiply_rows(const int* A, int* C, int rows) {
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < rows; i += GEMM_MC) {
+        int block = std::min(GEMM_MC, rows - i);
+        gemm_dispatch(block, N, N, A + i * N, N, matrixB.data(), N, C + i * N, N);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -24,35 +50,88 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &currentRank);  // Get the current process ID
     MPI_Comm_size(MPI_COMM_WORLD, &totalProcesses); // Get total number of processes
 
-    int rowsPerProcess = N / totalProcesses;      // Number of rows each process handles
+    // --weighted: size each process's share of rows by its measured speed
+    // --pipelined [panels]: overlap scatter/gather of row panels with compute
+    // --density d: fraction of nonzero inputs; sparse inputs switch to CSR
+    bool weighted = false, pipelined = false;
+    int panels = 4;
+    double density = 1.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--weighted") == 0) weighted = true;
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) density = atof(argv[++i]);
+        else if (strcmp(argv[i], "--pipelined") == 0) {
+            pipelined = true;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) panels = atoi(argv[++i]);
+        }
+    }
+
+    matrixB.resize(N * N);
+
+    // Rows each process handles
+    RowDistribution rows = row_distribution_even(N, totalProcesses, N);
+    if (weighted) {
+        int sampleRows = std::min(GEMM_MC, N);
+        std::vector<int> sampleA(sampleRows * N), sampleC(sampleRows * N);
+        double speed = measure_rows_per_second(sampleRows, [&](int r) {
+            multiply_rows(sampleA.data(), sampleC.data(), r);
+        });
+        rows = row_distribution_measured(N, N, speed, MPI_COMM_WORLD);
+    }
+    int rowsPerProcess = rows.rows(currentRank);
+    localMatrixA.resize(rowsPerProcess * N);
+    localMatrixC.resize(rowsPerProcess * N);
 
     if (currentRank == 0) {
-        srand(time(NULL));                       // Seed random number generator
-        initialize_matrices();                   // Initialize matrixA and matrixB with random values
+        matrixA.resize(N * N);
+        resultMatrix.resize(N * N);
+        initialize_matrices(counter_rng_seed(), density);  // RNG_SEED=n for repeatable inputs
+    }
+
+    // Below SPARSE_DENSITY_THRESHOLD both inputs go to CSR and only their
+    // nonzeros are distributed: A in row blocks of equal nnz, B in full
+    if (sparse_mpi_route(matrixA.data(), matrixB.data(), N, MPI_COMM_WORLD)) {
+        SparseMpiTimes times = sparse_mpi_multiply(matrixA.data(), matrixB.data(), resultMatrix.data(), N,
+                                                   MPI_INT, MPI_COMM_WORLD);
+        if (currentRank == 0) {
+            std::cout << "Sparse MPI + OpenMP (CSR, nnz A " << times.nnzA << ", B " << times.nnzB
+                      << ", C " << times.nnzC << "): " << times.total << " seconds end to end, "
+                      << times.compute << " compute on rank 0\n";
+            if (N <= SPARSE_CHECK_MAX && !sparse_matches_dense(matrixA.data(), matrixB.data(), resultMatrix.data(), N))
+                std::cout << "Sparse result differs from the dense product\n";
+        }
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (pipelined) {
+        // Slices of one row block per thread keep every thread busy between MPI progress calls
+        PipelineTimes times = pipelined_multiply(
+            matrixA.data(), matrixB.data(), resultMatrix.data(), N, rows,
+            localMatrixA.data(), localMatrixC.data(), panels, GEMM_MC * omp_get_max_threads(),
+            multiply_rows, MPI_COMM_WORLD);
+        if (currentRank == 0) {
+            std::cout << "Pipelined MPI + OpenMP (" << panels << " panels): " << times.total << " seconds end to end, "
+                      << times.compute << " compute, " << times.comm_wait << " waiting on communication\n";
+        }
+        MPI_Finalize();
+        return 0;
     }
 
     // Broadcast matrixB to all processes
-    MPI_Bcast(matrixB, N * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(matrixB.data(), N * N, MPI_INT, 0, MPI_COMM_WORLD);
     // Distribute rows of matrixA to each process
-    MPI_Scatter(matrixA, rowsPerProcess * N, MPI_INT, localMatrixA, rowsPerProcess * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(matrixA.data(), rows.counts.data(), rows.displs.data(), MPI_INT,
+                 localMatrixA.data(), rows.counts[currentRank], MPI_INT, 0, MPI_COMM_WORLD);
 
     double startTime = MPI_Wtime();             // Start the timer
 
-    // Perform matrix multiplication using OpenMP parallel loops
-    #pragma omp parallel for
-    for (int i = 0; i < rowsPerProcess; i++) {
-        for (int j = 0; j < N; j++) {
-            localMatrixC[i][j] = 0;
-            for (int k = 0; k < N; k++) {
-                localMatrixC[i][j] += localMatrixA[i][k] * matrixB[k][j];
-            }
-        }
-    }
+    multiply_rows(localMatrixA.data(), localMatrixC.data(), rowsPerProcess);
 
     double endTime = MPI_Wtime();               // Stop the timer
 
     // Gather the results from all processes into the final resultMatrix
-    MPI_Gather(localMatrixC, rowsPerProcess * N, MPI_INT, resultMatrix, rowsPerProcess * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(localMatrixC.data(), rows.counts[currentRank], MPI_INT,
+                resultMatrix.data(), rows.counts.data(), rows.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
 
     if (currentRank == 0) {
         std::cout << "Parallel Execution Time (MPI + OpenMP): " << (endTime - startTime) << " seconds\n";
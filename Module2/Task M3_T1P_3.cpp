@@ -1,39 +1,169 @@
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
+#include <cstring>
 #include <ctime>
+#include <vector>
 #include <mpi.h>
 #include <CL/cl.h>
+#include "row_distribution.h"
+#include "cl_program_cache.h"
+#include "counter_rng.h"
+#include "gemm_batched_cl.h"
 
 const int N = 1000;
+const int BATCH_SIZE = 256;  // Independent products in the --batched run
+const int BATCH_N = 32;      // Their edge
 
-int matrixA[N][N], matrixB[N][N], resultMatrix[N][N];
-int localMatrixA[N][N], localMatrixC[N][N];
+// Row-major heap buffers; matrixA and resultMatrix are only allocated on rank 0
+std::vector<int> matrixA, matrixB, resultMatrix;
+std::vector<int> localMatrixA, localMatrixC;
 
+// 2D tiled kernel. A work-group computes a TS x TS tile of C. It stages
+// TS x TS tiles of A and B through __local memory, so each global element is
+// read once per tile instead of once per multiply-add. Each work-item keeps
+// WPT results in registers, spaced TS / WPT rows apart. TS and WPT are set
+// per device through the build options.
 const char* kernelSource = R"(
+#define RTS (TS / WPT)
+
 __kernel void mat_mul(
-    __global int* matrixA,
-    __global int* matrixB,
-    __global int* resultMatrix,
-    int N,
-    int rows_per_proc
+    const int M,
+    const int N,
+    const int K,
+    __global const int* matrixA,
+    __global const int* matrixB,
+    __global int* resultMatrix
 ) {
-    int row = get_global_id(0);
-    for (int j = 0; j < N; j++) {
-        int sum = 0;
-        for (int k = 0; k < N; k++) {
-            sum += matrixA[row * N + k] * matrixB[k * N + j];
+    const int col = get_local_id(0);
+    const int row = get_local_id(1);
+    const int tileRow = get_group_id(1) * TS;
+    const int globalCol = get_group_id(0) * TS + col;
+
+    __local int tileA[TS][TS];
+    __local int tileB[TS][TS];
+
+    int acc[WPT];
+    for (int w = 0; w < WPT; w++) acc[w] = 0;
+
+    for (int t = 0; t < K; t += TS) {
+        for (int w = 0; w < WPT; w++) {
+            int r = row + w * RTS;
+            int aRow = tileRow + r, aCol = t + col;
+            int bRow = t + r;
+            tileA[r][col] = (aRow < M && aCol < K) ? matrixA[aRow * K + aCol] : 0;
+            tileB[r][col] = (bRow < K && globalCol < N) ? matrixB[bRow * N + globalCol] : 0;
         }
-        resultMatrix[row * N + j] = sum;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TS; k++) {
+            int b = tileB[k][col];
+            for (int w = 0; w < WPT; w++) acc[w] += tileA[row + w * RTS][k] * b;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int w = 0; w < WPT; w++) {
+        int r = tileRow + row + w * RTS;
+        if (r < M && globalCol < N) resultMatrix[r * N + globalCol] = acc[w];
     }
 })";
 
-// Function to randomly initialize matrixA and matrixB
-void initialize_matrices() {
-    for (int i = 0; i < N; i++)
-        for (int j = 0; j < N; j++) {
-            matrixA[i][j] = rand() % 10;
-            matrixB[i][j] = rand() % 10;
+// Tile edge and results per work-item, largest first
+struct TileConfig {
+    int ts, wpt;
+};
+const TileConfig tileCandidates[] = { { 32, 8 }, { 16, 4 }, { 8, 2 }, { 4, 1 } };
+
+// Build mat_mul with the largest tile whose work-group and two local tiles
+// fit this device. Returns the kernel and fills in the chosen tile.
+cl_kernel build_mat_mul(cl_context context, cl_device_id device, cl_program& program, TileConfig& tile,
+                        bool& cacheHit) {
+    size_t maxGroup = 0;
+    cl_ulong localMem = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxGroup), &maxGroup, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMem), &localMem, NULL);
+
+    for (const TileConfig& candidate : tileCandidates) {
+        size_t groupSize = candidate.ts * (candidate.ts / candidate.wpt);
+        if (groupSize > maxGroup || 2 * sizeof(int) * candidate.ts * candidate.ts > localMem) continue;
+
+        char options[64];
+        snprintf(options, sizeof(options), "-DTS=%d -DWPT=%d", candidate.ts, candidate.wpt);
+        program = cl_build_program_cached(context, device, kernelSource, options, &cacheHit);
+        if (!program) continue;
+
+        cl_int err;
+        cl_kernel kernel = clCreateKernel(program, "mat_mul", &err);
+        size_t kernelGroup = 0;
+        if (err == CL_SUCCESS)
+            clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelGroup), &kernelGroup, NULL);
+        if (err == CL_SUCCESS && kernelGroup >= groupSize) {
+            tile = candidate;
+            return kernel;
         }
+        // Kernel uses too many registers for this group size on this device
+        if (err == CL_SUCCESS) clReleaseKernel(kernel);
+        clReleaseProgram(program);
+    }
+    return NULL;
+}
+
+// Function to randomly initialize matrixA and matrixB (0..9, counter_rng.h)
+void initialize_matrices(uint64_t seed) {
+    counter_rng_fill(matrixA.data(), (size_t)N * N, 0, counter_rng_stream(seed, 0), 10);
+    counter_rng_fill(matrixB.data(), (size_t)N * N, 0, counter_rng_stream(seed, 1), 10);
+}
+
+// Run mat_mul on `rows` rows of A already in bufA, writing bufC
+void run_mat_mul(cl_command_queue queue, cl_kernel kernel, const TileConfig& tile,
+                 cl_mem bufA, cl_mem bufB, cl_mem bufC, int rows) {
+    clSetKernelArg(kernel, 0, sizeof(int), &rows);
+    clSetKernelArg(kernel, 1, sizeof(int), &N);
+    clSetKernelArg(kernel, 2, sizeof(int), &N);
+    clSetKernelArg(kernel, 3, sizeof(cl_mem), &bufA);
+    clSetKernelArg(kernel, 4, sizeof(cl_mem), &bufB);
+    clSetKernelArg(kernel, 5, sizeof(cl_mem), &bufC);
+
+    // One work-group per TS x TS tile of C, TS x TS/WPT work-items each
+    size_t tilesX = (N + tile.ts - 1) / tile.ts, tilesY = (rows + tile.ts - 1) / tile.ts;
+    size_t local[2] = { (size_t)tile.ts, (size_t)(tile.ts / tile.wpt) };
+    size_t global[2] = { tilesX * local[0], tilesY * local[1] };
+    if (rows > 0) clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global, local, 0, NULL, NULL);
+    clFinish(queue);
+}
+
+// --batched: BATCH_SIZE small products in one launch (gemm_batched_cl.h),
+// checked against the sequential host batch
+void run_batched(cl_context context, cl_device_id device, cl_command_queue queue) {
+    ClBatchedGemm gemm;
+    bool cacheHit = false;
+    if (!cl_batched_gemm_create(context, device, gemm, &cacheHit)) {
+        std::cout << "[OpenCL] Could not build gemm_batched for this device\n";
+        return;
+    }
+    gemm_batched_cl_use(context, queue, gemm);
+
+    long elements = (long)BATCH_N * BATCH_N;
+    std::vector<int> A(BATCH_SIZE * elements), B(BATCH_SIZE * elements);
+    std::vector<int> C(BATCH_SIZE * elements), expected(BATCH_SIZE * elements);
+    uint64_t seed = counter_rng_seed();
+    counter_rng_fill(A.data(), A.size(), 0, counter_rng_stream(seed, 2), 10);
+    counter_rng_fill(B.data(), B.size(), 0, counter_rng_stream(seed, 3), 10);
+
+    Executor deviceExec(BACKEND_OPENCL), hostExec(BACKEND_SERIAL);
+    double start = MPI_Wtime();
+    bool onDevice = gemm_strided_batched(deviceExec, BATCH_SIZE, BATCH_N, BATCH_N, BATCH_N, A.data(), BATCH_N, elements,
+                                         B.data(), BATCH_N, elements, C.data(), BATCH_N, elements);
+    double batchTime = MPI_Wtime() - start;
+    gemm_strided_batched(hostExec, BATCH_SIZE, BATCH_N, BATCH_N, BATCH_N, A.data(), BATCH_N, elements,
+                         B.data(), BATCH_N, elements, expected.data(), BATCH_N, elements);
+
+    std::cout << "Batched OpenCL Time (" << BATCH_SIZE << " products of " << BATCH_N << "x" << BATCH_N << ", "
+              << (onDevice ? "on the device" : "fell back to the host") << "): " << batchTime << " seconds\n";
+    if (C != expected) std::cout << "Batched OpenCL result differs from the host batch\n";
+    cl_batched_gemm_release(gemm);
+}
 
 int main(int argc, char** argv) {
     int currentRank, totalProcesses;
@@ -45,18 +175,6 @@ int main(int argc, char** argv) {
         std::cout << "[MPI] Running with " << totalProcesses << " process(es)\n";
     }
 
-    int rowsPerProcess = N / totalProcesses;      // Number of rows each process handles
-
-    if (currentRank == 0) {
-        srand(time(NULL));                       // Seed random number generator
-        initialize_matrices();                   // Initialize matrixA and matrixB with random values
-    }
-
-    // Broadcast matrixB to all processes
-    MPI_Bcast(matrixB, N * N, MPI_INT, 0, MPI_COMM_WORLD);
-    // Distribute rows of matrixA to each process
-    MPI_Scatter(matrixA, rowsPerProcess * N, MPI_INT, localMatrixA, rowsPerProcess * N, MPI_INT, 0, MPI_COMM_WORLD);
-
     // OpenCL setup
     cl_platform_id platform;
     cl_device_id device;
@@ -74,37 +192,79 @@ int main(int argc, char** argv) {
     context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
     queue = clCreateCommandQueueWithProperties(context, device, 0, &err);
 
-    // Create buffers
-    bufA = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(int) * rowsPerProcess * N, NULL, &err);
+    // Build OpenCL program, reusing a cached binary for this device when there is one
+    TileConfig tile;
+    bool cacheHit = false;
+    double buildStart = MPI_Wtime();
+    kernel = build_mat_mul(context, device, program, tile, cacheHit);
+    double buildTime = MPI_Wtime() - buildStart;
+    if (!kernel) {
+        std::cerr << "Rank " << currentRank << ": could not build mat_mul for this device\n";
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (currentRank == 0) {
+        std::cout << "[OpenCL] Program " << (cacheHit ? "loaded from cache" : "built from source") << " in "
+                  << buildTime << " seconds, tile " << tile.ts << "x" << tile.ts << ", " << tile.wpt
+                  << " results per work-item\n";
+    }
+
+    matrixB.resize(N * N);
     bufB = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(int) * N * N, NULL, &err);
-    bufC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int) * rowsPerProcess * N, NULL, &err);
 
-    // Write data to buffers
-    err = clEnqueueWriteBuffer(queue, bufA, CL_TRUE, 0, sizeof(int) * rowsPerProcess * N, localMatrixA, 0, NULL, NULL);
-    err = clEnqueueWriteBuffer(queue, bufB, CL_TRUE, 0, sizeof(int) * N * N, matrixB, 0, NULL, NULL);
+    bool weighted = false, batched = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--weighted") == 0) weighted = true;
+        else if (strcmp(argv[i], "--batched") == 0) batched = true;
+    }
+
+    // Rows each process handles: even split, or sized by measured device speed with --weighted
+    RowDistribution rows = row_distribution_even(N, totalProcesses, N);
+    if (weighted) {
+        int sampleRows = std::min(64, N);
+        cl_mem sampleA = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(int) * sampleRows * N, NULL, &err);
+        cl_mem sampleC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int) * sampleRows * N, NULL, &err);
+        double speed = measure_rows_per_second(sampleRows, [&](int r) {
+            run_mat_mul(queue, kernel, tile, sampleA, bufB, sampleC, r);
+        });
+        clReleaseMemObject(sampleA);
+        clReleaseMemObject(sampleC);
+        rows = row_distribution_measured(N, N, speed, MPI_COMM_WORLD);
+    }
+    int rowsPerProcess = rows.rows(currentRank);
+    localMatrixA.resize(rowsPerProcess * N);
+    localMatrixC.resize(rowsPerProcess * N);
+
+    if (currentRank == 0) {
+        matrixA.resize(N * N);
+        resultMatrix.resize(N * N);
+        initialize_matrices(counter_rng_seed());  // RNG_SEED=n for repeatable inputs
+    }
 
-    // Build OpenCL program
-    program = clCreateProgramWithSource(context, 1, &kernelSource, NULL, &err);
-    err = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
-    kernel = clCreateKernel(program, "mat_mul", &err);
+    // Broadcast matrixB to all processes
+    MPI_Bcast(matrixB.data(), N * N, MPI_INT, 0, MPI_COMM_WORLD);
+    // Distribute rows of matrixA to each process
+    MPI_Scatterv(matrixA.data(), rows.counts.data(), rows.displs.data(), MPI_INT,
+                 localMatrixA.data(), rows.counts[currentRank], MPI_INT, 0, MPI_COMM_WORLD);
 
-    // Set kernel arguments
-    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufA);
-    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufB);
-    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufC);
-    err |= clSetKernelArg(kernel, 3, sizeof(int), &N);
-    err |= clSetKernelArg(kernel, 4, sizeof(int), &rowsPerProcess);
+    // Create buffers (at least one row so zero-row ranks still get valid objects)
+    size_t localBytes = sizeof(int) * std::max(rowsPerProcess, 1) * N;
+    bufA = clCreateBuffer(context, CL_MEM_READ_ONLY, localBytes, NULL, &err);
+    bufC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, localBytes, NULL, &err);
 
-    // Set global size for OpenCL kernel
-    size_t global[1] = { static_cast<size_t>(rowsPerProcess) };
+    // Write data to buffers
+    if (rowsPerProcess > 0)
+        err = clEnqueueWriteBuffer(queue, bufA, CL_TRUE, 0, sizeof(int) * rowsPerProcess * N, localMatrixA.data(), 0, NULL, NULL);
+    err = clEnqueueWriteBuffer(queue, bufB, CL_TRUE, 0, sizeof(int) * N * N, matrixB.data(), 0, NULL, NULL);
 
     double startTime = MPI_Wtime();             // Start the timer
-    err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global, NULL, 0, NULL, NULL);
-    clFinish(queue);
+    run_mat_mul(queue, kernel, tile, bufA, bufB, bufC, rowsPerProcess);
     double endTime = MPI_Wtime();               // Stop the timer
 
     // Read results from buffer
-    err = clEnqueueReadBuffer(queue, bufC, CL_TRUE, 0, sizeof(int) * rowsPerProcess * N, localMatrixC, 0, NULL, NULL);
+    if (rowsPerProcess > 0)
+        err = clEnqueueReadBuffer(queue, bufC, CL_TRUE, 0, sizeof(int) * rowsPerProcess * N, localMatrixC.data(), 0, NULL, NULL);
+
+    if (batched && currentRank == 0) run_batched(context, device, queue);
 
     // Release OpenCL resources
     clReleaseMemObject(bufA);
@@ -116,7 +276,8 @@ int main(int argc, char** argv) {
     clReleaseContext(context);
 
     // Gather the results from all processes into the final resultMatrix
-    MPI_Gather(localMatrixC, rowsPerProcess * N, MPI_INT, resultMatrix, rowsPerProcess * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(localMatrixC.data(), rows.counts[currentRank], MPI_INT,
+                resultMatrix.data(), rows.counts.data(), rows.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
 
     if (currentRank == 0) {
         std::cout << "MPI + OpenCL execution Time: " << (endTime - startTime) << " seconds\n";
@@ -1,48 +1,51 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <vector>
 #include <mpi.h>
 #include <pthread.h>
+#include "matrix.h"
+#include "row_distribution.h"
+#include "mpi_pipeline.h"
+#include "thread_pool.h"
+#include "gemm_fixed.h"
+#include "sparse_mpi.h"
+#include "counter_rng.h"
 
 #define N 100  // Matrix size
 #define MAX_THREADS 4  // Maximum number of threads
 
-int matrix_A[N][N], matrix_B[N][N], matrix_C[N][N];  // Matrices A, B, and C for multiplication
+std::vector<int> matrix_A, matrix_B, matrix_C;  // Row-major matrices A, B, and C (A and C on rank 0 only)
 
 int rows_per_process;  // Rows per process
-int sub_matrix_A[N][N], sub_matrix_C[N][N];  // Sub-matrices for each process
+std::vector<int> sub_matrix_A, sub_matrix_C;  // Sub-matrices for each process
 int rank;  // MPI rank of the process
 
-// Structure to hold thread-specific data
-struct ThreadData {
-    int start_row;  // Starting row for the thread
-    int end_row;  // Ending row for the thread
-};
-
-// Thread function to perform matrix multiplication for a specific range of rows
-void* multiply_thread(void* arg) {
-    ThreadData* data = (ThreadData*)arg;  // Extract thread data
-
-    // Multiply sub-matrix A with matrix B and store the result in sub-matrix C
-    for (int i = data->start_row; i < data->end_row; i++) {
-        for (int j = 0; j < N; j++) {
-            sub_matrix_C[i][j] = 0;  // Initialize result for cell (i, j)
-            for (int k = 0; k < N; k++) {
-                sub_matrix_C[i][j] += sub_matrix_A[i][k] * matrix_B[k][j];  // Matrix multiplication
-            }
-        }
-    }
-
-    pthread_exit(NULL);  // Exit the thread
+// Multiply `rows` rows of A with matrix B into C on the thread pool. Threads
+// pull chunks of rows from a shared counter, so every row is computed and a
+// slow thread does not hold up the rest.
+void multiply_rows(ThreadPool& pool, const int* A, int* C, int rows) {
+    pool.parallel_for(rows, gemm_row_chunk(rows, pool.size()), [=](int begin, int end) {
+        // Fixed-size N x N kernel when N is compiled in, gemm_blocked otherwise
+        gemm_dispatch(end - begin, N, N, A + begin * N, N, matrix_B.data(), N, C + begin * N, N);
+    });
 }
 
-// Function to initialize matrices A and B with random values
-void initialize_matrices() {
-    for (int i = 0; i < N; i++)
-        for (int j = 0; j < N; j++) {
-            matrix_A[i][j] = rand() % 10;  // Random values between 0 and 9
-            matrix_B[i][j] = rand() % 10;  // Random values between 0 and 9
-        }
+// Function to initialize matrices A and B with random values between 0 and 9
+// from the counter-based generator (counter_rng.h); with density below 1.0
+// each entry is nonzero with that probability
+void initialize_matrices(uint64_t seed, double density) {
+    uint64_t seed_A = counter_rng_stream(seed, 0), seed_B = counter_rng_stream(seed, 1);
+    if (density >= 1.0) {
+        counter_rng_fill(matrix_A.data(), (size_t)N * N, 0, seed_A, 10);
+        counter_rng_fill(matrix_B.data(), (size_t)N * N, 0, seed_B, 10);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)N * N; i++) {
+        matrix_A[i] = sparse_random_entry(seed_A, i, density);
+        matrix_B[i] = sparse_random_entry(seed_B, i, density);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -52,40 +55,88 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);  // Get the rank of the process
     MPI_Comm_size(MPI_COMM_WORLD, &total_processes);  // Get the total number of processes
 
-    rows_per_process = N / total_processes;  // Calculate number of rows per process
+    // --weighted: split rows by each process's measured speed
+    // --pipelined [panels]: overlap scatter/gather of row panels with compute
+    // --density d: fraction of nonzero inputs; sparse inputs switch to CSR
+    bool weighted = false, pipelined = false;
+    int panels = 4;
+    double density = 1.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--weighted") == 0) weighted = true;
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) density = atof(argv[++i]);
+        else if (strcmp(argv[i], "--pipelined") == 0) {
+            pipelined = true;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) panels = atoi(argv[++i]);
+        }
+    }
+
+    ThreadPool pool(MAX_THREADS);  // Threads are created once and reused for every multiply
+    matrix_B.resize(N * N);
+
+    // Split rows evenly by default
+    RowDistribution rows = row_distribution_even(N, total_processes, N);
+    if (weighted) {
+        int sample_rows = std::min(GEMM_MC, N);
+        std::vector<int> sample_A(sample_rows * N), sample_C(sample_rows * N);
+        double speed = measure_rows_per_second(sample_rows, [&](int r) {
+            multiply_rows(pool, sample_A.data(), sample_C.data(), r);
+        });
+        rows = row_distribution_measured(N, N, speed, MPI_COMM_WORLD);
+    }
+    rows_per_process = rows.rows(rank);  // Number of rows this process handles
+    sub_matrix_A.resize(rows_per_process * N);
+    sub_matrix_C.resize(rows_per_process * N);
 
     // Only rank 0 initializes the matrices A and B
     if (rank == 0) {
-        srand(time(NULL));  // Seed random number generator
-        initialize_matrices();  // Initialize matrix_A and matrix_B with random values
+        matrix_A.resize(N * N);
+        matrix_C.resize(N * N);
+        initialize_matrices(counter_rng_seed(), density);  // RNG_SEED=n for repeatable inputs
+    }
+
+    // Sparse inputs go through CSR (sparse_mpi.h): only nonzeros travel
+    if (sparse_mpi_route(matrix_A.data(), matrix_B.data(), N, MPI_COMM_WORLD)) {
+        SparseMpiTimes times = sparse_mpi_multiply(matrix_A.data(), matrix_B.data(), matrix_C.data(), N,
+                                                   MPI_INT, MPI_COMM_WORLD);
+        if (rank == 0) {
+            std::cout << "Sparse MPI (CSR, nnz A " << times.nnzA << ", B " << times.nnzB << ", C " << times.nnzC
+                      << "): " << times.total << " seconds end to end, " << times.compute << " compute on rank 0\n";
+            if (N <= SPARSE_CHECK_MAX && !sparse_matches_dense(matrix_A.data(), matrix_B.data(), matrix_C.data(), N))
+                std::cout << "Sparse result differs from the dense product\n";
+        }
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (pipelined) {
+        PipelineTimes times = pipelined_multiply(
+            matrix_A.data(), matrix_B.data(), matrix_C.data(), N, rows,
+            sub_matrix_A.data(), sub_matrix_C.data(), panels, GEMM_MC * pool.size(),
+            [&](const int* A, int* C, int r) { multiply_rows(pool, A, C, r); }, MPI_COMM_WORLD);
+        if (rank == 0) {
+            std::cout << "Pipelined MPI + Pthreads (" << panels << " panels): " << times.total << " seconds end to end, "
+                      << times.compute << " compute, " << times.comm_wait << " waiting on communication\n";
+        }
+        MPI_Finalize();
+        return 0;
     }
 
     // Broadcast matrix B to all processes
-    MPI_Bcast(matrix_B, N * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(matrix_B.data(), N * N, MPI_INT, 0, MPI_COMM_WORLD);
     // Scatter rows of matrix A to all processes
-    MPI_Scatter(matrix_A, rows_per_process * N, MPI_INT, sub_matrix_A, rows_per_process * N, MPI_INT, 0, MPI_COMM_WORLD);
-
-    pthread_t threads[MAX_THREADS];  // Array to store thread IDs
-    ThreadData thread_data[MAX_THREADS];  // Array to store thread data
+    MPI_Scatterv(matrix_A.data(), rows.counts.data(), rows.displs.data(), MPI_INT,
+                 sub_matrix_A.data(), rows.counts[rank], MPI_INT, 0, MPI_COMM_WORLD);
 
     double start_time = MPI_Wtime();  // Start timing the computation
 
-    // Create threads to perform matrix multiplication in parallel
-    for (int t = 0; t < MAX_THREADS; t++) {
-        thread_data[t].start_row = t * (rows_per_process / MAX_THREADS);  // Assign start row
-        thread_data[t].end_row = (t + 1) * (rows_per_process / MAX_THREADS);  // Assign end row
-        pthread_create(&threads[t], NULL, multiply_thread, (void*)&thread_data[t]);  // Create thread
-    }
-
-    // Wait for all threads to finish
-    for (int t = 0; t < MAX_THREADS; t++) {
-        pthread_join(threads[t], NULL);  // Join each thread
-    }
+    // Perform matrix multiplication in parallel on the pool
+    multiply_rows(pool, sub_matrix_A.data(), sub_matrix_C.data(), rows_per_process);
 
     double end_time = MPI_Wtime();  // End timing the computation
 
     // Gather the result from all processes
-    MPI_Gather(sub_matrix_C, rows_per_process * N, MPI_INT, matrix_C, rows_per_process * N, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(sub_matrix_C.data(), rows.counts[rank], MPI_INT,
+                matrix_C.data(), rows.counts.data(), rows.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
 
     // Only rank 0 prints the execution time
     if (rank == 0) {
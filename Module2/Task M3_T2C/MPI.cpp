@@ -3,34 +3,45 @@
 #include <vector>
 #include <algorithm>
 #include <chrono>
+#include <climits>
+#include <cstdlib>
+#include "../counter_rng.h"
+#include "../radix_sort.h"
+#include "../row_distribution.h"
 
 using namespace std;
 using namespace chrono;
 
-// Partition function for quicksort
-int partition(vector<int>& arr, int left, int right) {
-    int pivot = arr[right];
-    int i = left - 1;
-    for(int j = left; j < right; j++) {
-        if(arr[j] <= pivot) {
-            swap(arr[++i], arr[j]);
+// Keys are bounded ints, so each rank sorts its share with the LSD radix
+// sort from radix_sort.h. It replaces the Lomuto quicksort, which made
+// n log n comparisons at best and degraded towards quadratic on repeated
+// keys; radix_sort is four linear passes per call. radix_sort falls back to
+// std::sort below RADIX_SORT_MIN keys, which every rank's share of the
+// default 10000 keys is; pass a larger count (at least RADIX_SORT_MIN per
+// rank) to run the radix path. Rank 0 then merges the sorted runs rather
+// than sorting the gathered array again.
+const int DEFAULT_ELEMENTS = 10000;
+
+// Merge the sorted runs data[displs[r], displs[r] + counts[r]) in place,
+// neighbouring pairs at a time, so the ranks' runs become one sorted array
+// in log2(runs) linear passes
+void merge_runs(vector<int>& data, const vector<int>& counts, const vector<int>& displs) {
+    int runs = (int)counts.size();
+    for(int width = 1; width < runs; width *= 2) {
+        for(int left = 0; left + width < runs; left += 2 * width) {
+            int right = min(left + 2 * width, runs) - 1;
+            auto first = data.begin() + displs[left];
+            auto middle = data.begin() + displs[left + width];
+            auto last = data.begin() + displs[right] + counts[right];
+            inplace_merge(first, middle, last);
         }
     }
-    swap(arr[i + 1], arr[right]);
-    return i + 1;
-}
-
-// Recursive quicksort
-void quicksort(vector<int>& arr, int left, int right) {
-    if(left < right) {
-        int p = partition(arr, left, right);
-        quicksort(arr, left, p - 1);
-        quicksort(arr, p + 1, right);
-    }
 }
 
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv);
+    // Optional argument: number of keys (default DEFAULT_ELEMENTS)
+    long requested = argc > 1 ? atol(argv[1]) : DEFAULT_ELEMENTS;
 
     int test_rank, test_size;
     MPI_Comm_rank(MPI_COMM_WORLD, &test_rank);
@@ -41,39 +52,48 @@ int main(int argc, char** argv) {
 
     steady_clock::time_point start_time, end_time;
 
+    if(requested <= 0 || requested > INT_MAX) {
+        if(test_rank == 0) cerr << "Number of keys must be between 1 and " << INT_MAX << endl;
+        MPI_Finalize();
+        return 1;
+    }
+
     if(test_rank == 0) {
-        total_elements = 10000;
+        total_elements = (int)requested;
         all_data.resize(total_elements);
-        for(int i = 0; i < total_elements; ++i) {
-            all_data[i] = rand() % 1000000;
-        }
+        counter_rng_fill(all_data.data(), total_elements, 0, counter_rng_seed(1), 1000000);
         start_time = steady_clock::now();
     }
 
     MPI_Bcast(&total_elements, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-    int part_size = total_elements / test_size;
-    vector<int> local_data(part_size);
+    // The total_elements % test_size leftover keys go one each to the lowest
+    // ranks, so none are dropped
+    RowDistribution parts = row_distribution_even(total_elements, test_size, 1);
+    vector<int> local_data(parts.counts[test_rank]);
 
-    MPI_Scatter(all_data.data(), part_size, MPI_INT,
-                local_data.data(), part_size, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(all_data.data(), parts.counts.data(), parts.displs.data(), MPI_INT,
+                 local_data.data(), parts.counts[test_rank], MPI_INT, 0, MPI_COMM_WORLD);
 
-    quicksort(local_data, 0, part_size - 1);
+    radix_sort(local_data);
 
     vector<int> final_data;
     if(test_rank == 0) final_data.resize(total_elements);
 
-    MPI_Gather(local_data.data(), part_size, MPI_INT,
-               final_data.data(), part_size, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(local_data.data(), parts.counts[test_rank], MPI_INT,
+                final_data.data(), parts.counts.data(), parts.displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
 
     if(test_rank == 0) {
-        sort(final_data.begin(), final_data.end());
+        merge_runs(final_data, parts.counts, parts.displs);
         end_time = steady_clock::now();
         auto time_taken = duration_cast<milliseconds>(end_time - start_time);
 
         cout << "Top 10 sorted numbers: ";
-        for(int i = 0; i < 10; ++i) cout << final_data[i] << " ";
+        for(int i = 0; i < min(10, total_elements); ++i) cout << final_data[i] << " ";
         cout << "\nExecution Time: " << time_taken.count() << " ms" << endl;
+        cout << "Per-rank sort: " << ((size_t)parts.counts[test_size - 1] >= RADIX_SORT_MIN ? "radix" : "std::sort")
+             << " (" << parts.counts[test_size - 1] << " to " << parts.counts[0] << " keys per rank, radix from "
+             << RADIX_SORT_MIN << ")" << (is_sorted(final_data.begin(), final_data.end()) ? "" : ", NOT SORTED") << endl;
     }
 
     MPI_Finalize();
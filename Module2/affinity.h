@@ -0,0 +1,154 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// Thread pinning for NUMA machines. Linux places a page on the socket of the
+// thread that first writes it, so a buffer is only local to its readers when
+// each thread touches its own part first and then stays on that core.
+//
+// compact: fill one socket's cores before moving to the next (threads share
+//          caches; best when the working set fits one socket)
+// scatter: alternate sockets, distinct physical cores first (uses every
+//          memory controller; best for bandwidth-bound loops)
+// none:    leave placement to the OS
+//
+// The policy comes from the AFFINITY environment variable (default scatter,
+// so a multi-socket machine spreads its threads and their first-touched
+// pages over every socket instead of packing them onto socket 0).
+
+enum AffinityPolicy { AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER };
+
+inline const char* affinity_policy_name(AffinityPolicy policy) {
+    static const char* names[] = { "none", "compact", "scatter" };
+    return names[policy];
+}
+
+inline AffinityPolicy affinity_policy_from_env() {
+    const char* env = getenv("AFFINITY");
+    if (env && strcmp(env, "none") == 0) return AFFINITY_NONE;
+    if (env && strcmp(env, "compact") == 0) return AFFINITY_COMPACT;
+    return AFFINITY_SCATTER;
+}
+
+struct CpuInfo {
+    int cpu, package, core, sibling;  // sibling: SMT thread index within the core
+};
+
+inline int affinity_read_topology(int cpu, const char* field, int fallback) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, field);
+    FILE* file = fopen(path, "r");
+    if (!file) return fallback;
+    int value = fallback;
+    if (fscanf(file, "%d", &value) != 1) value = fallback;
+    fclose(file);
+    return value;
+}
+
+inline std::vector<CpuInfo> affinity_scan_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<CpuInfo> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        CpuInfo info = { cpu, affinity_read_topology(cpu, "physical_package_id", 0),
+                         affinity_read_topology(cpu, "core_id", cpu), 0 };
+        for (const CpuInfo& other : cpus)
+            if (other.package == info.package && other.core == info.core) info.sibling++;
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+// CPUs this process may run on, with their socket and core from sysfs. Read
+// once, before any pinning narrows the calling thread's own mask.
+inline const std::vector<CpuInfo>& affinity_topology() {
+    static const std::vector<CpuInfo> cpus = affinity_scan_topology();
+    return cpus;
+}
+
+inline int affinity_socket_count(const std::vector<CpuInfo>& cpus) {
+    std::vector<int> packages;
+    for (const CpuInfo& info : cpus)
+        if (std::find(packages.begin(), packages.end(), info.package) == packages.end()) packages.push_back(info.package);
+    return (int)packages.size();
+}
+
+// CPU ids in the order threads 0, 1, 2, ... are placed under `policy`
+inline std::vector<int> affinity_cpu_order(AffinityPolicy policy) {
+    std::vector<CpuInfo> cpus = affinity_topology();
+    std::vector<int> order;
+    if (policy == AFFINITY_COMPACT) {
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.sibling < b.sibling;
+        });
+        for (const CpuInfo& info : cpus) order.push_back(info.cpu);
+    } else if (policy == AFFINITY_SCATTER) {
+        // Per socket: one thread per physical core first, then SMT siblings;
+        // then deal the sockets out round-robin
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            if (a.package != b.package) return a.package < b.package;
+            if (a.sibling != b.sibling) return a.sibling < b.sibling;
+            return a.core < b.core;
+        });
+        std::vector<std::vector<int>> sockets;
+        for (size_t i = 0; i < cpus.size(); i++) {
+            if (i == 0 || cpus[i].package != cpus[i - 1].package) sockets.emplace_back();
+            sockets.back().push_back(cpus[i].cpu);
+        }
+        for (size_t slot = 0; order.size() < cpus.size(); slot++)
+            for (const std::vector<int>& socket : sockets)
+                if (slot < socket.size()) order.push_back(socket[slot]);
+    }
+    return order;
+}
+
+// Pin the calling thread to the CPU `thread_index` is assigned under `policy`
+inline void affinity_pin_thread(AffinityPolicy policy, int thread_index) {
+    if (policy == AFFINITY_NONE) return;
+    static const std::vector<int> compact = affinity_cpu_order(AFFINITY_COMPACT);
+    static const std::vector<int> scatter = affinity_cpu_order(AFFINITY_SCATTER);
+    const std::vector<int>& order = policy == AFFINITY_COMPACT ? compact : scatter;
+    if (order.empty()) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(order[thread_index % order.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// One-line summary for benchmark output, e.g. "scatter over 2 sockets, 32 cpus"
+inline std::string affinity_describe(AffinityPolicy policy) {
+    const std::vector<CpuInfo>& cpus = affinity_topology();
+    int sockets = affinity_socket_count(cpus);
+    return std::string(affinity_policy_name(policy)) + " over " + std::to_string(sockets) +
+           (sockets == 1 ? " socket, " : " sockets, ") + std::to_string(cpus.size()) + " cpus";
+}
+
+#ifdef _OPENMP
+#include <omp.h>
+
+// Pin every thread of the next OpenMP team (and so of later teams of the same
+// size, which reuse the same threads) to its CPU under `policy`
+inline void affinity_pin_openmp(AffinityPolicy policy, int threads) {
+    #pragma omp parallel num_threads(threads)
+    affinity_pin_thread(policy, omp_get_thread_num());
+}
+#endif
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "affinity.h"
+#include "counter_rng.h"
+#include "matrix.h"
+#include "thread_pool.h"
+#include "vector_ops.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// One kernel API over interchangeable shared-memory backends. A kernel is
+// written once against Executor::parallel_for; the backend decides how the
+// iteration space is split and run:
+//
+//   serial    one call over the whole range on the calling thread
+//   threads   std::thread per call, one static block each
+//   pthreads  persistent ThreadPool (thread_pool.h), chunks from a shared counter
+//   openmp    OpenMP parallel region, one static block per thread
+//   opencl    device kernels where a kernel has one (gemm_batched.h); any
+//             host-side loop runs serially on the calling thread
+//
+// The backend comes from --backend NAME, else the BACKEND environment
+// variable, else the program's default. The vector add programs (M2_S2P_1,
+// M2_S2P_2, M2_S3P.1), the sort programs (M2_T2C_*), M2.T1P and matmul_bench
+// (including each rank's local rows in its MPI backends) run on these
+// executors; distribution stays in the MPI code.
+//
+// Every kernel reports its wall time to the hook set with
+// backend_set_timing_hook, with the same arguments whatever the backend.
+
+enum Backend { BACKEND_SERIAL, BACKEND_THREADS, BACKEND_PTHREADS, BACKEND_OPENMP, BACKEND_OPENCL, BACKEND_COUNT };
+
+inline const char* backend_name(Backend backend) {
+    static const char* names[] = { "serial", "threads", "pthreads", "openmp", "opencl" };
+    return names[backend];
+}
+
+// False for backends whose parallel work runs on a device
+inline bool backend_on_host(Backend backend) { return backend != BACKEND_OPENCL; }
+
+inline bool backend_from_name(const char* name, Backend& backend) {
+    for (int b = 0; b < BACKEND_COUNT; b++) {
+        if (strcmp(name, backend_name((Backend)b)) == 0) {
+            backend = (Backend)b;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --backend NAME on the command line, else $BACKEND, else `fallback`
+inline Backend backend_select(int argc, char** argv, Backend fallback = BACKEND_OPENMP) {
+    Backend backend = fallback;
+    const char* env = getenv("BACKEND");
+    if (env) backend_from_name(env, backend);
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--backend") == 0) backend_from_name(argv[i + 1], backend);
+    return backend;
+}
+
+inline int backend_default_threads() {
+    const char* env = getenv("BACKEND_THREADS");
+    if (env && atoi(env) > 0) return atoi(env);
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
+
+// Timing hook: kernel name, backend, thread count and milliseconds
+typedef std::function<void(const char* kernel, Backend backend, int threads, double ms)> BackendTimingHook;
+
+inline BackendTimingHook& backend_timing_hook() {
+    static BackendTimingHook hook;
+    return hook;
+}
+
+inline void backend_set_timing_hook(const BackendTimingHook& hook) { backend_timing_hook() = hook; }
+
+class Executor {
+public:
+    // Worker t is pinned to its CPU under `placement` (affinity.h); the
+    // calling thread is worker 0 of every backend but serial
+    explicit Executor(Backend backend, int threads = backend_default_threads(),
+                      AffinityPolicy placement = AFFINITY_NONE)
+        : backend_(backend), threads_(backend == BACKEND_SERIAL || !backend_on_host(backend) || threads < 1 ? 1 : threads),
+          placement_(placement) {
+        if (backend_ == BACKEND_PTHREADS)
+            pool_.reset(new ThreadPool(threads_, [placement](int thread) { affinity_pin_thread(placement, thread); }));
+        if (backend_ == BACKEND_THREADS) affinity_pin_thread(placement, 0);
+#ifdef _OPENMP
+        if (backend_ == BACKEND_OPENMP && placement != AFFINITY_NONE) affinity_pin_openmp(placement, threads_);
+#endif
+    }
+
+    Backend backend() const { return backend_; }
+    int threads() const { return threads_; }
+
+    // Call body(begin, end) over disjoint ranges covering [0, count). Ranges
+    // are at least `grain` long (except the last), so tiny loops stay on one
+    // thread. Returns once every range has run.
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) return;
+        if (grain < 1) grain = 1;
+        size_t parts = std::min<size_t>(threads_, (count + grain - 1) / grain);
+        if (parts <= 1) return body(0, count);
+
+        switch (backend_) {
+        case BACKEND_THREADS:
+            run_threads(parts, [&](size_t p) { run_block(count, parts, p, body); });
+            break;
+        case BACKEND_PTHREADS: {
+            // Several chunks per thread so faster threads take more of them
+            size_t chunk = std::max(grain, count / (parts * 8));
+            size_t chunks = (count + chunk - 1) / chunk;
+            pool_->parallel_for((int)chunks, 1, [&](int first, int last) {
+                for (int c = first; c < last; c++)
+                    body(c * chunk, std::min(count, (c + 1) * chunk));
+            });
+            break;
+        }
+        case BACKEND_OPENMP:
+#ifdef _OPENMP
+            #pragma omp parallel num_threads((int)parts)
+            run_block(count, omp_get_num_threads(), omp_get_thread_num(), body);
+            break;
+#endif
+        default:
+            body(0, count);
+        }
+    }
+
+    // Chunks of at most `chunk` iterations dealt round-robin: worker t runs
+    // chunks t, t + threads(), ... on every call, like an OpenMP
+    // schedule(static, chunk) loop. Data a worker first touched through such
+    // a loop comes back to the same worker, so NUMA placement is kept.
+    void parallel_for_static(size_t count, size_t chunk, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) return;
+        if (chunk < 1) chunk = 1;
+        size_t chunks = (count + chunk - 1) / chunk;
+        auto deal = [&](size_t worker, size_t workers) {
+            for (size_t c = worker; c < chunks; c += workers) body(c * chunk, std::min(count, (c + 1) * chunk));
+        };
+
+        switch (backend_) {
+        case BACKEND_THREADS:
+            run_threads(std::min<size_t>(threads_, chunks), [&](size_t t) { deal(t, threads_); });
+            break;
+        case BACKEND_PTHREADS:
+            pool_->parallel_for_static((int)count, (int)chunk, [&](int begin, int end) { body(begin, end); });
+            break;
+        case BACKEND_OPENMP:
+#ifdef _OPENMP
+            #pragma omp parallel num_threads(threads_)
+            deal(omp_get_thread_num(), omp_get_num_threads());
+            break;
+#endif
+        default:
+            deal(0, 1);
+        }
+    }
+
+private:
+    // fn(p) for p < parts, p > 0 on new pinned threads and 0 on the caller
+    void run_threads(size_t parts, const std::function<void(size_t)>& fn) {
+        std::vector<std::thread> workers;
+        for (size_t p = 1; p < parts; p++)
+            workers.emplace_back([&, p] {
+                affinity_pin_thread(placement_, (int)p);
+                fn(p);
+            });
+        fn(0);
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    // Block `part` of `parts` near-equal blocks (the same split as an OpenMP
+    // schedule(static) loop)
+    static void run_block(size_t count, size_t parts, size_t part, const std::function<void(size_t, size_t)>& body) {
+        size_t share = count / parts, extra = count % parts;
+        size_t begin = part * share + std::min(part, extra);
+        size_t end = begin + share + (part < extra ? 1 : 0);
+        if (begin < end) body(begin, end);
+    }
+
+    Backend backend_;
+    int threads_;
+    AffinityPolicy placement_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+// Reports the lifetime of one kernel call to the timing hook
+class BackendTimer {
+public:
+    BackendTimer(const char* kernel, const Executor& exec)
+        : kernel_(kernel), exec_(exec), start_(std::chrono::steady_clock::now()) {}
+    ~BackendTimer() {
+        const BackendTimingHook& hook = backend_timing_hook();
+        if (!hook) return;
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start_;
+        hook(kernel_, exec_.backend(), exec_.threads(), ms.count());
+    }
+
+private:
+    const char* kernel_;
+    const Executor& exec_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Kernels. Each one states only the per-range work; partitioning belongs to
+// the executor.
+
+// v[i] = value `i` of the counter-based stream `seed` in [0, range)
+// (counter_rng.h). The ranges match backend_vector_add's, so under a static
+// backend each page is first touched by the worker that later adds it.
+inline void backend_random_fill(Executor& exec, int* v, size_t n, uint64_t seed, int range) {
+    BackendTimer timer("random_fill", exec);
+    exec.parallel_for(n, 1 << 16, [=](size_t begin, size_t end) {
+        counter_rng_fill(v + begin, end - begin, begin, seed, range);
+    });
+}
+
+// c = a + b; c is written with streaming stores (vector_ops.h)
+inline void backend_vector_add(Executor& exec, const int* a, const int* b, int* c, size_t n) {
+    BackendTimer timer("vector_add", exec);
+    exec.parallel_for(n, 1 << 16, [=](size_t begin, size_t end) {
+        add_stream(a + begin, b + begin, c + begin, end - begin);
+    });
+}
+
+// C = A * B for a rows x n block of A and an n x n B (row-major). The rows
+// are cut into about four ranges per worker on GEMM_MR boundaries (as
+// gemm_batch_parts does), so a small matrix still spreads over every worker
+// instead of fitting in one GEMM_MC block
+template <typename T>
+void backend_matmul_rows(Executor& exec, const T* A, const T* B, T* C, int rows, int n) {
+    BackendTimer timer("matmul", exec);
+    int panels = (rows + GEMM_MR - 1) / GEMM_MR;
+    int parts = std::max(1, std::min(4 * exec.threads(), panels));
+    exec.parallel_for(parts, 1, [=](size_t first, size_t last) {
+        for (size_t part = first; part < last; part++) {
+            int begin = std::min(rows, (int)((long)part * panels / parts) * GEMM_MR);
+            int end = std::min(rows, (int)((long)(part + 1) * panels / parts) * GEMM_MR);
+            memset(C + (size_t)begin * n, 0, sizeof(T) * (end - begin) * n);
+            gemm_blocked(end - begin, n, n, A + (size_t)begin * n, n, B, n, C + (size_t)begin * n, n);
+        }
+    });
+}
+
+// C = A * B for n x n row-major matrices
+template <typename T>
+void backend_matmul(Executor& exec, const T* A, const T* B, T* C, int n) {
+    backend_matmul_rows(exec, A, B, C, n, n);
+}
+
+// Ascending sort as a sample sort: splitters from a regular sample cut the
+// keys into buckets, every range counts and then scatters its keys into
+// bucket order, and the buckets are sorted independently. All three phases
+// are parallel_for loops, so any backend runs it.
+template <typename T>
+void backend_sort(Executor& exec, T* data, size_t n) {
+    BackendTimer timer("sort", exec);
+    size_t buckets = (size_t)exec.threads() * 4;
+    if (exec.threads() == 1 || n < buckets * 1024) {
+        std::sort(data, data + n);
+        return;
+    }
+
+    // Splitters: every 32nd element of a sorted evenly spaced sample
+    std::vector<T> sample(buckets * 32);
+    for (size_t i = 0; i < sample.size(); i++) sample[i] = data[i * (n / sample.size())];
+    std::sort(sample.begin(), sample.end());
+    std::vector<T> splitters;
+    for (size_t b = 1; b < buckets; b++) splitters.push_back(sample[b * 32]);
+    auto bucket_of = [&](const T& key) {
+        return (size_t)(std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin());
+    };
+
+    // Per-range bucket counts, then each (range, bucket) pair's output offset
+    size_t ranges = exec.threads(), range_len = (n + ranges - 1) / ranges;
+    std::vector<size_t> counts(ranges * buckets, 0);
+    exec.parallel_for(ranges, 1, [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; r++)
+            for (size_t i = r * range_len; i < std::min(n, (r + 1) * range_len); i++)
+                counts[r * buckets + bucket_of(data[i])]++;
+    });
+    std::vector<size_t> offsets(ranges * buckets), bucket_begin(buckets + 1, 0);
+    size_t total = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        bucket_begin[b] = total;
+        for (size_t r = 0; r < ranges; r++) {
+            offsets[r * buckets + b] = total;
+            total += counts[r * buckets + b];
+        }
+    }
+    bucket_begin[buckets] = total;
+
+    std::vector<T> scratch(n);
+    exec.parallel_for(ranges, 1, [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; r++) {
+            size_t* next = &offsets[r * buckets];
+            for (size_t i = r * range_len; i < std::min(n, (r + 1) * range_len); i++)
+                scratch[next[bucket_of(data[i])]++] = data[i];
+        }
+    });
+
+    exec.parallel_for(buckets, 1, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; b++) {
+            std::sort(scratch.begin() + bucket_begin[b], scratch.begin() + bucket_begin[b + 1]);
+            std::copy(scratch.begin() + bucket_begin[b], scratch.begin() + bucket_begin[b + 1], data + bucket_begin[b]);
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "backend.h"
+#include "counter_rng.h"
+#include "hugepage_alloc.h"
+
+// Runs vector add, matrix multiply and sort through the backend layer in
+// backend.h and checks each result against the serial backend.
+//
+//   ./backend_run [--backend serial|threads|pthreads|openmp|all] [--threads T]
+//                 [--kernels add,matmul,sort] [--size N] [--matrix N]
+//
+// Without --backend the BACKEND environment variable picks one (default
+// openmp); "all" runs every host backend on the same inputs for an A/B comparison.
+// Output is one CSV row per kernel call from the shared timing hook.
+
+using namespace std;
+
+struct RunConfig {
+    vector<Backend> backends;
+    int threads = backend_default_threads();
+    bool add = true, matmul = true, sort = true;
+    size_t size = 100000000;  // Vector add and sort length
+    int matrix = 512;         // Matrix multiply n
+};
+
+bool parse_args(int argc, char** argv, RunConfig& config) {
+    config.backends = { backend_select(argc, argv) };
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) return false;
+        string arg = argv[i], value = argv[++i];
+        if (arg == "--backend") {
+            Backend backend;
+            if (value == "all") {
+                config.backends.clear();
+                for (int b = 0; b < BACKEND_COUNT; b++)
+                    if (backend_on_host((Backend)b)) config.backends.push_back((Backend)b);
+            } else if (!backend_from_name(value.c_str(), backend)) {
+                return false;
+            }
+        } else if (arg == "--threads") {
+            config.threads = atoi(value.c_str());
+        } else if (arg == "--kernels") {
+            config.add = value.find("add") != string::npos;
+            config.matmul = value.find("matmul") != string::npos;
+            config.sort = value.find("sort") != string::npos;
+        } else if (arg == "--size") {
+            config.size = strtoul(value.c_str(), NULL, 10);
+        } else if (arg == "--matrix") {
+            config.matrix = atoi(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    // These kernels have no device version, so opencl would only run them serially
+    for (Backend backend : config.backends)
+        if (!backend_on_host(backend)) return false;
+    return config.threads > 0 && config.matrix > 0;
+}
+
+int main(int argc, char** argv) {
+    RunConfig config;
+    if (!parse_args(argc, argv, config)) {
+        cerr << "usage: " << argv[0] << " [--backend serial|threads|pthreads|openmp|all] [--threads T]"
+             << " [--kernels add,matmul,sort] [--size N] [--matrix N]" << endl;
+        return 1;
+    }
+
+    backend_set_timing_hook([](const char* kernel, Backend backend, int threads, double ms) {
+        cout << kernel << "," << backend_name(backend) << "," << threads << "," << ms << endl;
+    });
+
+    // Inputs and serial references, made once (the reference runs are untimed)
+    uint64_t seed = counter_rng_seed();  // RNG_SEED=n for repeatable inputs
+    size_t n = config.size;
+    int m = config.matrix;
+    int *v1 = hugepage_alloc_array<int>(n), *v2 = hugepage_alloc_array<int>(n), *v3 = hugepage_alloc_array<int>(n);
+    counter_rng_fill(v1, n, 0, counter_rng_stream(seed, 0), 100);
+    counter_rng_fill(v2, n, 0, counter_rng_stream(seed, 1), 100);
+    Matrix<int> A(m, m), B(m, m), C(m, m), C_ref(m, m);
+    counter_rng_fill(A.data(), A.size(), 0, counter_rng_stream(seed, 2), 10);
+    counter_rng_fill(B.data(), B.size(), 0, counter_rng_stream(seed, 3), 10);
+    vector<int> keys(config.sort ? n : 0), sorted;
+    counter_rng_fill(keys.data(), keys.size(), 0, counter_rng_stream(seed, 4), 1000000);
+
+    BackendTimingHook hook = backend_timing_hook();
+    backend_set_timing_hook(nullptr);
+    Executor reference(BACKEND_SERIAL);
+    if (config.matmul) backend_matmul(reference, A.data(), B.data(), C_ref.data(), m);
+    if (config.sort) {
+        sorted = keys;
+        backend_sort(reference, sorted.data(), n);
+    }
+    backend_set_timing_hook(hook);
+
+    cout << "kernel,backend,threads,ms" << endl;
+    int failures = 0;
+    for (Backend backend : config.backends) {
+        Executor exec(backend, config.threads);
+        if (config.add) {
+            backend_vector_add(exec, v1, v2, v3, n);
+            for (size_t i = 0; i < n; i++)
+                if (v3[i] != v1[i] + v2[i]) {
+                    cerr << "vector_add " << backend_name(backend) << ": wrong result at " << i << endl;
+                    failures++;
+                    break;
+                }
+        }
+        if (config.matmul) {
+            backend_matmul(exec, A.data(), B.data(), C.data(), m);
+            if (memcmp(C.data(), C_ref.data(), C.size() * sizeof(int)) != 0) {
+                cerr << "matmul " << backend_name(backend) << ": wrong result" << endl;
+                failures++;
+            }
+        }
+        if (config.sort) {
+            vector<int> data = keys;
+            backend_sort(exec, data.data(), n);
+            if (data != sorted) {
+                cerr << "sort " << backend_name(backend) << ": wrong result" << endl;
+                failures++;
+            }
+        }
+    }
+
+    hugepage_free_array(v1, n);
+    hugepage_free_array(v2, n);
+    hugepage_free_array(v3, n);
+    return failures == 0 ? 0 : 2;
+}
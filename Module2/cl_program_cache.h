@@ -0,0 +1,131 @@
+#ifndef CL_PROGRAM_CACHE_H
+#define CL_PROGRAM_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <CL/cl.h>
+
+// On-disk cache of built OpenCL program binaries. The file name is a hash of
+// everything the binary depends on: device name, vendor, driver and device
+// version, build options and kernel source. A cache hit skips the runtime
+// compiler entirely, which is most of the start-up cost on CPU runtimes such
+// as POCL. The directory is $CL_CACHE_DIR, else $HOME/.cache/sit315-opencl.
+
+inline unsigned long long cl_cache_hash(const std::string& text, unsigned long long hash = 1469598103934665603ULL) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;  // 64-bit FNV-1a
+    }
+    return hash;
+}
+
+inline std::string cl_device_string(cl_device_id device, cl_device_info param) {
+    size_t size = 0;
+    if (clGetDeviceInfo(device, param, 0, NULL, &size) != CL_SUCCESS || size == 0) return "";
+    std::string value(size, '\0');
+    clGetDeviceInfo(device, param, size, &value[0], NULL);
+    return value;
+}
+
+inline std::string cl_cache_dir() {
+    if (const char* dir = getenv("CL_CACHE_DIR")) return dir;
+    const char* home = getenv("HOME");
+    if (!home) return ".";
+    std::string cache = std::string(home) + "/.cache";
+    mkdir(cache.c_str(), 0755);
+    return cache + "/sit315-opencl";
+}
+
+inline std::string cl_cache_path(cl_device_id device, const char* source, const char* options) {
+    unsigned long long key = cl_cache_hash(cl_device_string(device, CL_DEVICE_NAME));
+    key = cl_cache_hash(cl_device_string(device, CL_DEVICE_VENDOR), key);
+    key = cl_cache_hash(cl_device_string(device, CL_DRIVER_VERSION), key);
+    key = cl_cache_hash(cl_device_string(device, CL_DEVICE_VERSION), key);
+    key = cl_cache_hash(options ? options : "", key);
+    key = cl_cache_hash(source, key);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", key);
+    return cl_cache_dir() + name;
+}
+
+inline bool cl_cache_read(const std::string& path, std::vector<unsigned char>& binary) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    binary.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(binary.data(), 1, size, file) == (size_t)size;
+    fclose(file);
+    return ok;
+}
+
+// Write to a per-process temporary and rename, so ranks sharing a node never
+// see a half-written binary
+inline void cl_cache_write(const std::string& path, cl_program program) {
+    size_t size = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL) != CL_SUCCESS || size == 0) return;
+    std::vector<unsigned char> binary(size);
+    unsigned char* data = binary.data();
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(data), &data, NULL) != CL_SUCCESS) return;
+
+    mkdir(cl_cache_dir().c_str(), 0755);
+    std::string tmp = path + ".tmp." + std::to_string((long)getpid());
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (!file) return;
+    bool ok = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
+
+inline void cl_print_build_log(cl_program program, cl_device_id device) {
+    size_t log_size = 0;
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    std::vector<char> log(log_size + 1, '\0');
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), NULL);
+    fprintf(stderr, "%s\n", log.data());
+}
+
+// Build `source` for `device`, loading the binary from the cache when one
+// exists and storing it after a source build. `cache_hit` reports which path
+// was taken. Returns NULL (after printing the build log) on failure.
+inline cl_program cl_build_program_cached(cl_context context, cl_device_id device, const char* source,
+                                          const char* options, bool* cache_hit) {
+    std::string path = cl_cache_path(device, source, options);
+    cl_int err;
+    if (cache_hit) *cache_hit = false;
+
+    std::vector<unsigned char> binary;
+    if (cl_cache_read(path, binary)) {
+        size_t size = binary.size();
+        const unsigned char* data = binary.data();
+        cl_int status;
+        cl_program program = clCreateProgramWithBinary(context, 1, &device, &size, &data, &status, &err);
+        if (err == CL_SUCCESS && status == CL_SUCCESS &&
+            clBuildProgram(program, 1, &device, options, NULL, NULL) == CL_SUCCESS) {
+            if (cache_hit) *cache_hit = true;
+            return program;
+        }
+        // Stale or foreign binary: drop it and rebuild from source
+        if (program) clReleaseProgram(program);
+        remove(path.c_str());
+    }
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+    if (err != CL_SUCCESS) return NULL;
+    if (clBuildProgram(program, 1, &device, options, NULL, NULL) != CL_SUCCESS) {
+        cl_print_build_log(program, device);
+        clReleaseProgram(program);
+        return NULL;
+    }
+    cl_cache_write(path, program);
+    return program;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Counter-based random numbers: value i of a stream is a pure function of
+// (seed, i), the SplitMix64 output hash applied to the counter. There is no
+// state to share or lock, any thread or rank can produce any slice on its
+// own, and the data for a given seed is bit-identical whatever the thread or
+// rank count. Fills are vectorized: each lane hashes its own counter.
+
+const uint64_t COUNTER_RNG_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+// Value `index` of the stream `seed`
+inline uint64_t counter_rng(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * COUNTER_RNG_GAMMA;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Independent stream for a second vector or matrix from the same seed, e.g.
+// counter_rng_stream(seed, 0) for A and counter_rng_stream(seed, 1) for B
+inline uint64_t counter_rng_stream(uint64_t seed, uint64_t stream) {
+    return counter_rng(seed ^ COUNTER_RNG_GAMMA, stream);
+}
+
+// Uniform in [0, bound), by multiply-shift of the top 32 bits (no division)
+inline uint32_t counter_rng_below(uint64_t seed, uint64_t index, uint32_t bound) {
+    return (uint32_t)(((counter_rng(seed, index) >> 32) * bound) >> 32);
+}
+
+// Uniform in [0, 1) from the top 53 bits
+inline double counter_rng_uniform(uint64_t seed, uint64_t index) {
+    return (counter_rng(seed, index) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Seed from the RNG_SEED environment variable, otherwise `fallback`
+inline uint64_t counter_rng_seed(uint64_t fallback = (uint64_t)time(NULL)) {
+    const char* env = getenv("RNG_SEED");
+    if (env && *env) return strtoull(env, NULL, 10);
+    return fallback;
+}
+
+#define COUNTER_RNG_INLINE __attribute__((always_inline)) inline
+
+// VB bytes of 64-bit counters (a plain typedef would not depend on VB)
+template <int VB>
+struct CounterRngVec {
+    typedef uint64_t type __attribute__((vector_size(VB)));
+};
+
+// out[i] = counter_rng_below(seed, first + i, bound) for i < count, hashed
+// VB / 8 counters at a time in VB-byte vectors
+template <int VB, typename T>
+COUNTER_RNG_INLINE void counter_rng_fill_body(T* out, size_t count, uint64_t first, uint64_t seed, uint32_t bound) {
+    constexpr int lanes = VB / 8;
+    typedef typename CounterRngVec<VB>::type vec;
+    vec step, z0;
+    for (int l = 0; l < lanes; l++) {
+        step[l] = lanes * COUNTER_RNG_GAMMA;
+        z0[l] = seed + (first + l + 1) * COUNTER_RNG_GAMMA;
+    }
+    size_t i = 0;
+    for (vec z = z0; i + lanes <= count; i += lanes, z += step) {
+        vec h = z;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        h = ((((h ^ (h >> 31)) >> 32) * bound) >> 32);
+        for (int l = 0; l < lanes; l++) out[i + l] = (T)h[l];
+    }
+    for (; i < count; i++) out[i] = (T)counter_rng_below(seed, first + i, bound);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <typename T>
+__attribute__((target("avx2"))) void counter_rng_fill_avx2(T* out, size_t count, uint64_t first, uint64_t seed, uint32_t bound) {
+    counter_rng_fill_body<32>(out, count, first, seed, bound);
+}
+
+template <typename T>
+__attribute__((target("avx512f,avx512dq"))) void counter_rng_fill_avx512(T* out, size_t count, uint64_t first, uint64_t seed,
+                                                                       uint32_t bound) {
+    counter_rng_fill_body<64>(out, count, first, seed, bound);
+}
+#endif
+
+// Fill out[0, count) with elements first .. first + count - 1 of the stream,
+// each uniform in [0, bound). A thread or rank owning a slice passes that
+// slice's global start as `first`.
+template <typename T>
+void counter_rng_fill(T* out, size_t count, uint64_t first, uint64_t seed, uint32_t bound) {
+#if defined(__x86_64__) || defined(__i386__)
+    static const int isa = __builtin_cpu_supports("avx512dq") ? 512 : __builtin_cpu_supports("avx2") ? 256 : 0;
+    if (isa == 512) return counter_rng_fill_avx512(out, count, first, seed, bound);
+    if (isa == 256) return counter_rng_fill_avx2(out, count, first, seed, bound);
+#endif
+    counter_rng_fill_body<16>(out, count, first, seed, bound);
+}
+
+// counter_rng_fill split over the OpenMP threads in the blocks a
+// schedule(static) loop over the same range uses, so each page is first
+// touched by the thread that later reads it
+template <typename T>
+void counter_rng_fill_parallel(T* out, size_t count, uint64_t seed, uint32_t bound) {
+#ifdef _OPENMP
+    #pragma omp parallel
+    {
+        size_t threads = omp_get_num_threads(), t = omp_get_thread_num();
+        size_t share = count / threads, extra = count % threads;
+        size_t begin = t * share + (t < extra ? t : extra);
+        counter_rng_fill(out + begin, share + (t < extra), begin, seed, bound);
+    }
+#else
+    counter_rng_fill(out, count, 0, seed, bound);
+#endif
+}
+
+#endif
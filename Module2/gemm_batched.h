@@ -0,0 +1,101 @@
+#ifndef GEMM_BATCHED_H
+#define GEMM_BATCHED_H
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "backend.h"
+#include "matrix.h"
+
+// Batched GEMM: C[b] = A[b] * B[b] for many independent small matrices in a
+// single call, on any Executor (backend.h). One parallel loop covers the
+// whole batch and deals out (matrix, row block) work items, so a big batch
+// is spread across matrices and a small one is also split within each
+// matrix. Every C[b] is overwritten. The OpenCL kernel is in
+// gemm_batched_cl.h; gemm_batched_cl_use() there installs the device an
+// opencl executor sends strided batches to.
+
+// Device that runs a strided batch of packed int matrices (strides in
+// elements). False if it could not run the batch.
+typedef std::function<bool(int batch, int M, int N, int K, const int* A, long strideA, const int* B, long strideB,
+                           int* C, long strideC)> GemmBatchedDevice;
+
+// The device opencl executors run on; empty until gemm_batched_cl_use()
+inline GemmBatchedDevice& gemm_batched_device() {
+    static GemmBatchedDevice device;
+    return device;
+}
+
+// The device kernel reads packed int rows, so only those batches go to it
+inline bool gemm_batched_offload(int batch, int M, int N, int K, const int* A, int lda, long strideA,
+                                 const int* B, int ldb, long strideB, int* C, int ldc, long strideC) {
+    const GemmBatchedDevice& device = gemm_batched_device();
+    return device && lda == K && ldb == N && ldc == N && device(batch, M, N, K, A, strideA, B, strideB, C, strideC);
+}
+
+template <typename T>
+bool gemm_batched_offload(int, int, int, int, const T*, int, long, const T*, int, long, T*, int, long) {
+    return false;
+}
+
+// Row blocks per matrix: enough work items for about four per thread, but
+// never blocks of fewer than GEMM_MR rows
+inline int gemm_batch_parts(int batch, int M, int threads) {
+    int wanted = (4 * threads + batch - 1) / std::max(batch, 1);
+    int most = (M + GEMM_MR - 1) / GEMM_MR;
+    return std::max(1, std::min(wanted, most));
+}
+
+// Rows [begin, end) of part `part` out of `parts`, split on GEMM_MR boundaries
+inline void gemm_batch_rows(int M, int parts, int part, int& begin, int& end) {
+    int panels = (M + GEMM_MR - 1) / GEMM_MR;
+    begin = std::min(M, (int)((long)part * panels / parts) * GEMM_MR);
+    end = std::min(M, (int)((long)(part + 1) * panels / parts) * GEMM_MR);
+}
+
+template <typename T>
+void gemm_batch_item(int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc,
+                     int begin, int end) {
+    for (int i = begin; i < end; i++) memset(C + (size_t)i * ldc, 0, sizeof(T) * N);
+    gemm_blocked(end - begin, N, K, A + (size_t)begin * lda, lda, B, ldb, C + (size_t)begin * ldc, ldc);
+}
+
+// Pointer-array batch: A[b], B[b] and C[b] may live anywhere. The device
+// needs one buffer per operand, so an opencl executor runs this form on the
+// host (serially).
+template <typename T>
+void gemm_batched(Executor& exec, int batch, int M, int N, int K, const T* const* A, int lda,
+                  const T* const* B, int ldb, T* const* C, int ldc) {
+    BackendTimer timer("gemm_batched", exec);
+    int parts = gemm_batch_parts(batch, M, exec.threads());
+    exec.parallel_for((size_t)batch * parts, 1, [&](size_t first, size_t last) {
+        for (size_t item = first; item < last; item++) {
+            int b = (int)(item / parts), begin, end;
+            gemm_batch_rows(M, parts, (int)(item % parts), begin, end);
+            gemm_batch_item(N, K, A[b], lda, B[b], ldb, C[b], ldc, begin, end);
+        }
+    });
+}
+
+// Strided batch: matrix b starts at A + b * strideA, and so on. A stride of 0
+// shares one operand across the batch (e.g. one B for many A). An opencl
+// executor falls back to the host without an installed device, for other
+// element types and for padded rows; returns false when it did.
+template <typename T>
+bool gemm_strided_batched(Executor& exec, int batch, int M, int N, int K,
+                          const T* A, int lda, long strideA, const T* B, int ldb, long strideB,
+                          T* C, int ldc, long strideC) {
+    if (exec.backend() == BACKEND_OPENCL && gemm_batched_offload(batch, M, N, K, A, lda, strideA, B, ldb, strideB, C, ldc, strideC))
+        return true;
+    std::vector<const T*> a(batch), b(batch);
+    std::vector<T*> c(batch);
+    for (int i = 0; i < batch; i++) {
+        a[i] = A + i * strideA;
+        b[i] = B + i * strideB;
+        c[i] = C + i * strideC;
+    }
+    gemm_batched(exec, batch, M, N, K, a.data(), lda, b.data(), ldb, c.data(), ldc);
+    return exec.backend() != BACKEND_OPENCL;
+}
+
+#endif
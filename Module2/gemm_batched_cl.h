@@ -0,0 +1,171 @@
+#ifndef GEMM_BATCHED_CL_H
+#define GEMM_BATCHED_CL_H
+
+#include <climits>
+#include <CL/cl.h>
+#include "cl_program_cache.h"
+#include "gemm_batched.h"
+
+// OpenCL backend for the strided batched GEMM in gemm_batched.h. One launch
+// covers the whole batch: the third NDRange dimension picks the matrix, and
+// the first two tile it exactly like mat_mul in Task M3_T1P_3 (TS x TS tiles
+// staged through __local memory, WPT results per work-item). Small matrices
+// therefore fill the device through the batch instead of paying one launch
+// each.
+
+static const char* gemmBatchedSource = R"(
+#define RTS (TS / WPT)
+
+__kernel void gemm_batched(
+    const int M, const int N, const int K,
+    __global const int* A, const int strideA,
+    __global const int* B, const int strideB,
+    __global int* C, const int strideC
+) {
+    const int batch = get_group_id(2);
+    A += batch * strideA;
+    B += batch * strideB;
+    C += batch * strideC;
+
+    const int col = get_local_id(0);
+    const int row = get_local_id(1);
+    const int tileRow = get_group_id(1) * TS;
+    const int globalCol = get_group_id(0) * TS + col;
+
+    __local int tileA[TS][TS];
+    __local int tileB[TS][TS];
+
+    int acc[WPT];
+    for (int w = 0; w < WPT; w++) acc[w] = 0;
+
+    for (int t = 0; t < K; t += TS) {
+        for (int w = 0; w < WPT; w++) {
+            int r = row + w * RTS;
+            int aRow = tileRow + r, aCol = t + col;
+            int bRow = t + r;
+            tileA[r][col] = (aRow < M && aCol < K) ? A[aRow * K + aCol] : 0;
+            tileB[r][col] = (bRow < K && globalCol < N) ? B[bRow * N + globalCol] : 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TS; k++) {
+            int b = tileB[k][col];
+            for (int w = 0; w < WPT; w++) acc[w] += tileA[row + w * RTS][k] * b;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int w = 0; w < WPT; w++) {
+        int r = tileRow + row + w * RTS;
+        if (r < M && globalCol < N) C[r * N + globalCol] = acc[w];
+    }
+})";
+
+struct ClBatchedGemm {
+    cl_program program;
+    cl_kernel kernel;
+    int ts, wpt;
+};
+
+// Build gemm_batched with the largest tile the device supports. Tiles stop at
+// 16 since batched matrices are small and bigger tiles would mostly be padding.
+inline bool cl_batched_gemm_create(cl_context context, cl_device_id device, ClBatchedGemm& gemm, bool* cache_hit) {
+    static const int candidates[][2] = { { 16, 4 }, { 8, 2 }, { 4, 1 } };
+    size_t maxGroup = 0;
+    cl_ulong localMem = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxGroup), &maxGroup, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMem), &localMem, NULL);
+
+    for (const int* c : candidates) {
+        size_t groupSize = c[0] * (c[0] / c[1]);
+        if (groupSize > maxGroup || 2 * sizeof(int) * c[0] * c[0] > localMem) continue;
+
+        char options[64];
+        snprintf(options, sizeof(options), "-DTS=%d -DWPT=%d", c[0], c[1]);
+        cl_program program = cl_build_program_cached(context, device, gemmBatchedSource, options, cache_hit);
+        if (!program) continue;
+        cl_int err;
+        cl_kernel kernel = clCreateKernel(program, "gemm_batched", &err);
+        size_t kernelGroup = 0;
+        if (err == CL_SUCCESS)
+            clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelGroup), &kernelGroup, NULL);
+        if (err == CL_SUCCESS && kernelGroup >= groupSize) {
+            gemm.program = program;
+            gemm.kernel = kernel;
+            gemm.ts = c[0];
+            gemm.wpt = c[1];
+            return true;
+        }
+        // Kernel uses too many registers for this group size on this device
+        if (err == CL_SUCCESS) clReleaseKernel(kernel);
+        clReleaseProgram(program);
+    }
+    return false;
+}
+
+// Also uninstalls the device (see gemm_batched_cl_use)
+inline void cl_batched_gemm_release(ClBatchedGemm& gemm) {
+    gemm_batched_device() = nullptr;
+    clReleaseKernel(gemm.kernel);
+    clReleaseProgram(gemm.program);
+}
+
+// Enqueue C[b] = A[b] * B[b] for b < batch on device buffers; strides are in
+// elements (0 shares an operand across the batch)
+inline cl_int cl_batched_gemm_enqueue(cl_command_queue queue, const ClBatchedGemm& gemm, int batch, int M, int N,
+                                      int K, cl_mem A, int strideA, cl_mem B, int strideB, cl_mem C, int strideC) {
+    if (batch <= 0 || M <= 0 || N <= 0) return CL_SUCCESS;
+    clSetKernelArg(gemm.kernel, 0, sizeof(int), &M);
+    clSetKernelArg(gemm.kernel, 1, sizeof(int), &N);
+    clSetKernelArg(gemm.kernel, 2, sizeof(int), &K);
+    clSetKernelArg(gemm.kernel, 3, sizeof(cl_mem), &A);
+    clSetKernelArg(gemm.kernel, 4, sizeof(int), &strideA);
+    clSetKernelArg(gemm.kernel, 5, sizeof(cl_mem), &B);
+    clSetKernelArg(gemm.kernel, 6, sizeof(int), &strideB);
+    clSetKernelArg(gemm.kernel, 7, sizeof(cl_mem), &C);
+    clSetKernelArg(gemm.kernel, 8, sizeof(int), &strideC);
+
+    size_t tilesX = (N + gemm.ts - 1) / gemm.ts, tilesY = (M + gemm.ts - 1) / gemm.ts;
+    size_t local[3] = { (size_t)gemm.ts, (size_t)(gemm.ts / gemm.wpt), 1 };
+    size_t global[3] = { tilesX * local[0], tilesY * local[1], (size_t)batch };
+    return clEnqueueNDRangeKernel(queue, gemm.kernel, 3, NULL, global, local, 0, NULL, NULL);
+}
+
+// Host-memory convenience wrapper: one upload per operand, one launch, one
+// download. The download covers the whole strided range of C, so any gap
+// between result matrices is overwritten. Returns false if any OpenCL call fails.
+inline bool gemm_strided_batched_cl(cl_context context, cl_command_queue queue, const ClBatchedGemm& gemm,
+                                    int batch, int M, int N, int K, const int* A, int strideA,
+                                    const int* B, int strideB, int* C, int strideC) {
+    if (batch <= 0) return true;
+    size_t bytesA = sizeof(int) * ((size_t)(batch - 1) * strideA + (size_t)M * K);
+    size_t bytesB = sizeof(int) * ((size_t)(batch - 1) * strideB + (size_t)K * N);
+    size_t bytesC = sizeof(int) * ((size_t)(batch - 1) * strideC + (size_t)M * N);
+
+    cl_int errA, errB, errC;
+    cl_mem bufA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytesA, (void*)A, &errA);
+    cl_mem bufB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytesB, (void*)B, &errB);
+    cl_mem bufC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytesC, NULL, &errC);
+    bool ok = errA == CL_SUCCESS && errB == CL_SUCCESS && errC == CL_SUCCESS &&
+              cl_batched_gemm_enqueue(queue, gemm, batch, M, N, K, bufA, strideA, bufB, strideB, bufC, strideC) == CL_SUCCESS &&
+              clEnqueueReadBuffer(queue, bufC, CL_TRUE, 0, bytesC, C, 0, NULL, NULL) == CL_SUCCESS;
+
+    if (errA == CL_SUCCESS) clReleaseMemObject(bufA);
+    if (errB == CL_SUCCESS) clReleaseMemObject(bufB);
+    if (errC == CL_SUCCESS) clReleaseMemObject(bufC);
+    return ok;
+}
+
+// Send gemm_strided_batched calls on an opencl executor to this context, queue and
+// kernel until cl_batched_gemm_release. Strides beyond the kernel's int
+// arguments make the call fall back to the host.
+inline void gemm_batched_cl_use(cl_context context, cl_command_queue queue, const ClBatchedGemm& gemm) {
+    gemm_batched_device() = [context, queue, gemm](int batch, int M, int N, int K, const int* A, long strideA,
+                                                   const int* B, long strideB, int* C, long strideC) {
+        if (strideA > INT_MAX || strideB > INT_MAX || strideC > INT_MAX) return false;
+        return gemm_strided_batched_cl(context, queue, gemm, batch, M, N, K, A, (int)strideA, B, (int)strideB,
+                                       C, (int)strideC);
+    };
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef GEMM_FIXED_H
+#define GEMM_FIXED_H
+
+#include <array>
+#include <cstring>
+#include "matrix.h"
+
+// Matrix multiply with the sizes as template parameters. Every loop bound and
+// leading dimension is a compile-time constant, so the compiler unrolls the
+// k loop, vectorizes the register tile without remainder checks and drops
+// the packing gemm_blocked needs for unknown shapes. Best for small, hot,
+// fixed-shape products such as N x N in M2.T1P.
+
+// R x C row-major matrix in std::array storage, 64-byte aligned
+template <typename T, int R, int C>
+struct FixedMatrix {
+    alignas(64) std::array<T, (size_t)R * C> storage;
+
+    T* operator[](int row) { return storage.data() + (size_t)row * C; }
+    const T* operator[](int row) const { return storage.data() + (size_t)row * C; }
+    T* data() { return storage.data(); }
+    const T* data() const { return storage.data(); }
+};
+
+#define GEMM_FIXED_INLINE __attribute__((always_inline)) inline
+
+// Register tile of C (TR x TC, at most GEMM_MR x GEMM_NR) = A rows * B
+// columns. When TC is a power of two each tile row is held in VB-byte
+// vectors (the register width of the target), so the accumulators stay in
+// registers without relying on the auto-vectorizer.
+template <int VB, int TR, int TC, int K, int LDA, int LDB, int LDC, typename T>
+GEMM_FIXED_INLINE void gemm_fixed_tile(const T* A, const T* B, T* C) {
+    if constexpr ((TC & (TC - 1)) == 0) {
+        constexpr int bytes = TC * sizeof(T) < VB ? TC * sizeof(T) : VB;
+        constexpr int lanes = bytes / sizeof(T), V = TC / lanes;
+        typedef T vec __attribute__((vector_size(bytes)));
+        vec acc[TR][V] = {};
+        #pragma GCC unroll 2
+        for (int k = 0; k < K; k++) {
+            vec b[V];
+            #pragma GCC unroll 16
+            for (int v = 0; v < V; v++) memcpy(&b[v], B + k * LDB + v * lanes, sizeof(vec));
+            #pragma GCC unroll 16
+            for (int r = 0; r < TR; r++) {
+                #pragma GCC unroll 16
+                for (int v = 0; v < V; v++) acc[r][v] += A[r * LDA + k] * b[v];
+            }
+        }
+        for (int r = 0; r < TR; r++) memcpy(C + r * LDC, acc[r], sizeof(acc[r]));
+    } else {
+        T acc[TR][TC] = {};
+        for (int k = 0; k < K; k++) {
+            for (int r = 0; r < TR; r++) {
+                T a = A[r * LDA + k];
+                for (int c = 0; c < TC; c++) acc[r][c] += a * B[k * LDB + c];
+            }
+        }
+        for (int r = 0; r < TR; r++)
+            for (int c = 0; c < TC; c++) C[r * LDC + c] = acc[r][c];
+    }
+}
+
+// One TR-row strip of C; the N % GEMM_NR column tail is its own compile-time
+// tile (split into a vector part and a scalar rest), so no iteration carries
+// a bounds check
+template <int VB, int TR, int N, int K, typename T>
+GEMM_FIXED_INLINE void gemm_fixed_strip(const T* A, const T* B, T* C) {
+    constexpr int full = N / GEMM_NR * GEMM_NR;
+    constexpr int tail = N % GEMM_NR, wide = tail >= 8 ? 8 : tail >= 4 ? 4 : 0;
+    for (int j = 0; j < full; j += GEMM_NR) gemm_fixed_tile<VB, TR, GEMM_NR, K, K, N, N>(A, B + j, C + j);
+    if constexpr (wide > 0) gemm_fixed_tile<VB, TR, wide, K, K, N, N>(A, B + full, C + full);
+    if constexpr (tail > wide) gemm_fixed_tile<VB, TR, tail - wide, K, K, N, N>(A, B + full + wide, C + full + wide);
+}
+
+template <int VB, int N, int K, typename T>
+GEMM_FIXED_INLINE void gemm_fixed_rows_body(int rows, const T* A, const T* B, T* C) {
+    int i = 0;
+    for (; i + GEMM_MR <= rows; i += GEMM_MR)
+        gemm_fixed_strip<VB, GEMM_MR, N, K>(A + (size_t)i * K, B, C + (size_t)i * N);
+    switch (rows - i) {
+    case 3: gemm_fixed_strip<VB, 3, N, K>(A + (size_t)i * K, B, C + (size_t)i * N); break;
+    case 2: gemm_fixed_strip<VB, 2, N, K>(A + (size_t)i * K, B, C + (size_t)i * N); break;
+    case 1: gemm_fixed_strip<VB, 1, N, K>(A + (size_t)i * K, B, C + (size_t)i * N); break;
+    }
+}
+
+template <int VB, int M, int N, int K, typename T>
+GEMM_FIXED_INLINE void gemm_fixed_body(const T* A, const T* B, T* C) {
+    constexpr int full = M / GEMM_MR * GEMM_MR;
+    for (int i = 0; i < full; i += GEMM_MR) gemm_fixed_strip<VB, GEMM_MR, N, K>(A + i * K, B, C + i * N);
+    if constexpr (M % GEMM_MR != 0) gemm_fixed_strip<VB, M % GEMM_MR, N, K>(A + full * K, B, C + full * N);
+}
+
+// The bodies are compiled once per instruction set, like the gemm_kernels.h
+// micro-kernels, and picked with the same gemm_active_isa() dispatch
+#ifdef GEMM_X86
+template <int N, int K, typename T>
+__attribute__((target("sse4.1"))) void gemm_fixed_rows_sse41(int rows, const T* A, const T* B, T* C) {
+    gemm_fixed_rows_body<16, N, K>(rows, A, B, C);
+}
+
+template <int N, int K, typename T>
+__attribute__((target("avx2"))) void gemm_fixed_rows_avx2(int rows, const T* A, const T* B, T* C) {
+    gemm_fixed_rows_body<32, N, K>(rows, A, B, C);
+}
+
+template <int N, int K, typename T>
+__attribute__((target("avx512f"))) void gemm_fixed_rows_avx512(int rows, const T* A, const T* B, T* C) {
+    gemm_fixed_rows_body<64, N, K>(rows, A, B, C);
+}
+
+template <int M, int N, int K, typename T>
+__attribute__((target("sse4.1"))) void gemm_fixed_sse41(const T* A, const T* B, T* C) {
+    gemm_fixed_body<16, M, N, K>(A, B, C);
+}
+
+template <int M, int N, int K, typename T>
+__attribute__((target("avx2"))) void gemm_fixed_avx2(const T* A, const T* B, T* C) {
+    gemm_fixed_body<32, M, N, K>(A, B, C);
+}
+
+template <int M, int N, int K, typename T>
+__attribute__((target("avx512f"))) void gemm_fixed_avx512(const T* A, const T* B, T* C) {
+    gemm_fixed_body<64, M, N, K>(A, B, C);
+}
+#endif
+
+// C = A * B for `rows` rows of A (rows x K) with B K x N, all contiguous.
+// Only the row count is a runtime value, e.g. a rank's share in the MPI programs.
+template <int N, int K, typename T>
+void gemm_fixed_rows(int rows, const T* A, const T* B, T* C) {
+#ifdef GEMM_X86
+    if (gemm_active_isa() >= ISA_AVX512) return gemm_fixed_rows_avx512<N, K>(rows, A, B, C);
+    if (gemm_active_isa() >= ISA_AVX2) return gemm_fixed_rows_avx2<N, K>(rows, A, B, C);
+    if (gemm_active_isa() >= ISA_SSE41) return gemm_fixed_rows_sse41<N, K>(rows, A, B, C);
+#endif
+    gemm_fixed_rows_body<16, N, K>(rows, A, B, C);
+}
+
+// C = A * B with every dimension known at compile time
+template <int M, int N, int K, typename T>
+void gemm_fixed(const T* A, const T* B, T* C) {
+#ifdef GEMM_X86
+    if (gemm_active_isa() >= ISA_AVX512) return gemm_fixed_avx512<M, N, K>(A, B, C);
+    if (gemm_active_isa() >= ISA_AVX2) return gemm_fixed_avx2<M, N, K>(A, B, C);
+    if (gemm_active_isa() >= ISA_SSE41) return gemm_fixed_sse41<M, N, K>(A, B, C);
+#endif
+    gemm_fixed_body<16, M, N, K>(A, B, C);
+}
+
+template <int M, int N, int K, typename T>
+inline void gemm_fixed(const FixedMatrix<T, M, K>& A, const FixedMatrix<T, K, N>& B, FixedMatrix<T, M, N>& C) {
+    gemm_fixed<M, N, K>(A.data(), B.data(), C.data());
+}
+
+// Square sizes with a specialized kernel compiled in. Add a size here to give
+// it a fixed-size path in gemm_dispatch.
+template <int... Sizes>
+struct GemmFixedSizes {};
+typedef GemmFixedSizes<4, 8, 16, 32, 64, 100, 128> GemmFixedSquareSizes;
+
+template <typename T>
+using gemm_fixed_fn = void (*)(int rows, const T* A, const T* B, T* C);
+
+template <typename T>
+inline gemm_fixed_fn<T> gemm_fixed_lookup(int, int, GemmFixedSizes<>) {
+    return nullptr;
+}
+
+template <typename T, int Size, int... Rest>
+inline gemm_fixed_fn<T> gemm_fixed_lookup(int n, int k, GemmFixedSizes<Size, Rest...>) {
+    if (n == Size && k == Size) return gemm_fixed_rows<Size, Size, T>;
+    return gemm_fixed_lookup<T>(n, k, GemmFixedSizes<Rest...>());
+}
+
+// C = A * B (overwritten) for an M x K by K x N product. Contiguous operands
+// whose N and K match a compiled-in size take the fixed-size kernel, anything
+// else falls back to gemm_blocked.
+template <typename T>
+void gemm_dispatch(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+    if (lda == K && ldb == N && ldc == N) {
+        if (gemm_fixed_fn<T> fixed = gemm_fixed_lookup<T>(N, K, GemmFixedSquareSizes())) {
+            fixed(M, A, B, C);
+            return;
+        }
+    }
+    for (int i = 0; i < M; i++) memset(C + (size_t)i * ldc, 0, sizeof(T) * N);
+    gemm_blocked(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+#endif
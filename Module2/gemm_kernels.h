@@ -0,0 +1,215 @@
+#ifndef GEMM_KERNELS_H
+#define GEMM_KERNELS_H
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_X86 1
+#endif
+
+// Tile sizes for the blocked GEMM. A micro-panel of B (GEMM_KC x GEMM_NR)
+// stays in L1 across the whole GEMM_MC row block, the packed block of A
+// (GEMM_MC x GEMM_KC) stays in L2 and the packed panel of B
+// (GEMM_KC x GEMM_NC) is streamed from L3.
+const int GEMM_MR = 4;
+const int GEMM_NR = 16;
+const int GEMM_MC = 128;
+const int GEMM_KC = 256;
+const int GEMM_NC = 4096;
+
+// C[mr x nr] += Ap * Bp for one register tile of packed panels
+template <typename T>
+void gemm_micro_kernel(int kc, const T* Ap, const T* Bp, T* C, int ldc, int mr, int nr) {
+    T acc[GEMM_MR][GEMM_NR] = {};
+    for (int k = 0; k < kc; k++) {
+        for (int r = 0; r < GEMM_MR; r++) {
+            T a = Ap[r];
+            for (int c = 0; c < GEMM_NR; c++) acc[r][c] += a * Bp[c];
+        }
+        Ap += GEMM_MR;
+        Bp += GEMM_NR;
+    }
+    for (int r = 0; r < mr; r++)
+        for (int c = 0; c < nr; c++) C[(size_t)r * ldc + c] += acc[r][c];
+}
+
+typedef void (*gemm_kernel_fn)(int kc, const int* Ap, const int* Bp, int* C, int ldc, int mr, int nr);
+
+// Instruction sets an int32 micro-kernel exists for, slowest first
+enum GemmIsa { ISA_SCALAR, ISA_SSE41, ISA_AVX2, ISA_AVX512, ISA_COUNT };
+
+inline const char* gemm_isa_name(GemmIsa isa) {
+    static const char* names[ISA_COUNT] = { "scalar", "sse4.1", "avx2", "avx512" };
+    return names[isa];
+}
+
+// Add a full register tile back into C, or the mr x nr corner of it on edges
+inline void gemm_tile_add(const int* tile, int* C, int ldc, int mr, int nr) {
+    for (int r = 0; r < mr; r++)
+        for (int c = 0; c < nr; c++) C[(size_t)r * ldc + c] += tile[r * GEMM_NR + c];
+}
+
+#ifdef GEMM_X86
+
+__attribute__((target("sse4.1")))
+inline void gemm_kernel_sse41(int kc, const int* Ap, const int* Bp, int* C, int ldc, int mr, int nr) {
+    __m128i acc[GEMM_MR][4];
+    for (int r = 0; r < GEMM_MR; r++)
+        for (int v = 0; v < 4; v++) acc[r][v] = _mm_setzero_si128();
+
+    for (int k = 0; k < kc; k++) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(Bp + 0));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(Bp + 4));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(Bp + 8));
+        __m128i b3 = _mm_loadu_si128((const __m128i*)(Bp + 12));
+        for (int r = 0; r < GEMM_MR; r++) {
+            __m128i a = _mm_set1_epi32(Ap[r]);
+            acc[r][0] = _mm_add_epi32(acc[r][0], _mm_mullo_epi32(a, b0));
+            acc[r][1] = _mm_add_epi32(acc[r][1], _mm_mullo_epi32(a, b1));
+            acc[r][2] = _mm_add_epi32(acc[r][2], _mm_mullo_epi32(a, b2));
+            acc[r][3] = _mm_add_epi32(acc[r][3], _mm_mullo_epi32(a, b3));
+        }
+        Ap += GEMM_MR;
+        Bp += GEMM_NR;
+    }
+
+    if (mr == GEMM_MR && nr == GEMM_NR) {
+        for (int r = 0; r < GEMM_MR; r++) {
+            __m128i* row = (__m128i*)(C + (size_t)r * ldc);
+            for (int v = 0; v < 4; v++)
+                _mm_storeu_si128(row + v, _mm_add_epi32(_mm_loadu_si128(row + v), acc[r][v]));
+        }
+        return;
+    }
+    int tile[GEMM_MR * GEMM_NR];
+    for (int r = 0; r < GEMM_MR; r++)
+        for (int v = 0; v < 4; v++) _mm_storeu_si128((__m128i*)(tile + r * GEMM_NR + 4 * v), acc[r][v]);
+    gemm_tile_add(tile, C, ldc, mr, nr);
+}
+
+__attribute__((target("avx2")))
+inline void gemm_kernel_avx2(int kc, const int* Ap, const int* Bp, int* C, int ldc, int mr, int nr) {
+    __m256i acc[GEMM_MR][2];
+    for (int r = 0; r < GEMM_MR; r++)
+        acc[r][0] = acc[r][1] = _mm256_setzero_si256();
+
+    for (int k = 0; k < kc; k++) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(Bp + 0));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(Bp + 8));
+        for (int r = 0; r < GEMM_MR; r++) {
+            __m256i a = _mm256_set1_epi32(Ap[r]);
+            acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_mullo_epi32(a, b0));
+            acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_mullo_epi32(a, b1));
+        }
+        Ap += GEMM_MR;
+        Bp += GEMM_NR;
+    }
+
+    if (mr == GEMM_MR && nr == GEMM_NR) {
+        for (int r = 0; r < GEMM_MR; r++) {
+            __m256i* row = (__m256i*)(C + (size_t)r * ldc);
+            _mm256_storeu_si256(row + 0, _mm256_add_epi32(_mm256_loadu_si256(row + 0), acc[r][0]));
+            _mm256_storeu_si256(row + 1, _mm256_add_epi32(_mm256_loadu_si256(row + 1), acc[r][1]));
+        }
+        return;
+    }
+    int tile[GEMM_MR * GEMM_NR];
+    for (int r = 0; r < GEMM_MR; r++) {
+        _mm256_storeu_si256((__m256i*)(tile + r * GEMM_NR), acc[r][0]);
+        _mm256_storeu_si256((__m256i*)(tile + r * GEMM_NR + 8), acc[r][1]);
+    }
+    gemm_tile_add(tile, C, ldc, mr, nr);
+}
+
+__attribute__((target("avx512f")))
+inline void gemm_kernel_avx512(int kc, const int* Ap, const int* Bp, int* C, int ldc, int mr, int nr) {
+    __m512i acc[GEMM_MR];
+    for (int r = 0; r < GEMM_MR; r++) acc[r] = _mm512_setzero_si512();
+
+    for (int k = 0; k < kc; k++) {
+        __m512i b = _mm512_loadu_si512(Bp);
+        for (int r = 0; r < GEMM_MR; r++)
+            acc[r] = _mm512_add_epi32(acc[r], _mm512_mullo_epi32(_mm512_set1_epi32(Ap[r]), b));
+        Ap += GEMM_MR;
+        Bp += GEMM_NR;
+    }
+
+    if (nr == GEMM_NR) {
+        for (int r = 0; r < mr; r++) {
+            int* row = C + (size_t)r * ldc;
+            _mm512_storeu_si512(row, _mm512_add_epi32(_mm512_loadu_si512(row), acc[r]));
+        }
+        return;
+    }
+    // Partial column tile: masked load/store keeps it in registers
+    __mmask16 mask = (__mmask16)((1u << nr) - 1);
+    for (int r = 0; r < mr; r++) {
+        int* row = C + (size_t)r * ldc;
+        __m512i c = _mm512_maskz_loadu_epi32(mask, row);
+        _mm512_mask_storeu_epi32(row, mask, _mm512_add_epi32(c, acc[r]));
+    }
+}
+
+#endif
+
+inline bool gemm_isa_supported(GemmIsa isa) {
+    switch (isa) {
+    case ISA_SCALAR: return true;
+#ifdef GEMM_X86
+    case ISA_SSE41: return __builtin_cpu_supports("sse4.1");
+    case ISA_AVX2: return __builtin_cpu_supports("avx2");
+    case ISA_AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+    default: return false;
+    }
+}
+
+inline gemm_kernel_fn gemm_kernel_for(GemmIsa isa) {
+    switch (isa) {
+#ifdef GEMM_X86
+    case ISA_SSE41: return gemm_kernel_sse41;
+    case ISA_AVX2: return gemm_kernel_avx2;
+    case ISA_AVX512: return gemm_kernel_avx512;
+#endif
+    default: return gemm_micro_kernel<int>;
+    }
+}
+
+// Widest instruction set this CPU supports. GEMM_ISA=scalar|sse4.1|avx2|avx512
+// in the environment caps the choice, e.g. to compare variants on one node.
+inline GemmIsa gemm_detect_isa() {
+    int cap = ISA_COUNT - 1;
+    if (const char* env = getenv("GEMM_ISA")) {
+        for (int i = 0; i < ISA_COUNT; i++)
+            if (strcmp(env, gemm_isa_name((GemmIsa)i)) == 0) cap = i;
+    }
+    for (int i = cap; i > ISA_SCALAR; i--)
+        if (gemm_isa_supported((GemmIsa)i)) return (GemmIsa)i;
+    return ISA_SCALAR;
+}
+
+inline GemmIsa& gemm_active_isa() {
+    static GemmIsa isa = gemm_detect_isa();
+    return isa;
+}
+
+// Switch every subsequent int32 GEMM to the given variant (must be supported)
+inline void gemm_set_isa(GemmIsa isa) { gemm_active_isa() = isa; }
+
+// Micro-kernel used by gemm_blocked: the dispatched SIMD variant for int,
+// the portable template for every other element type
+template <typename T>
+struct GemmKernel {
+    typedef void (*fn)(int kc, const T* Ap, const T* Bp, T* C, int ldc, int mr, int nr);
+    static fn get() { return gemm_micro_kernel<T>; }
+};
+
+template <>
+struct GemmKernel<int> {
+    typedef gemm_kernel_fn fn;
+    static fn get() { return gemm_kernel_for(gemm_active_isa()); }
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef GEMM_NARROW_H
+#define GEMM_NARROW_H
+
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "gemm_kernels.h"
+
+// Blocked GEMM with narrow integer inputs and a wider accumulator, e.g.
+// int8 x int8 -> int32. Inputs of rand() % 10 fit in a byte, so storing them
+// as int8 cuts memory and network traffic by 4x against int32.
+//
+// Packed panels interleave GEMM_GROUP consecutive k values, so one 32-bit
+// lane holds 4 int8 or 2 int16 inputs. The AVX2 kernels multiply and add
+// whole groups with vpmaddubsw + vpmaddwd (int8) or vpmaddwd (int16).
+
+// k values packed per 32-bit lane: 4 for int8, 2 for int16, 1 otherwise
+template <typename In>
+struct GemmGroup {
+    static const int value = sizeof(In) < 4 ? 4 / (int)sizeof(In) : 1;
+};
+
+// Copy an mc x kc block of A into GEMM_MR-row micro-panels. Each row gives G
+// consecutive k values per group, and kc is zero-padded to a multiple of G.
+template <typename In>
+void pack_a_grouped(int mc, int kc, const In* A, int lda, In* packed) {
+    const int G = GemmGroup<In>::value;
+    for (int i = 0; i < mc; i += GEMM_MR) {
+        int mr = std::min(GEMM_MR, mc - i);
+        for (int k = 0; k < kc; k += G)
+            for (int r = 0; r < GEMM_MR; r++)
+                for (int g = 0; g < G; g++)
+                    *packed++ = (r < mr && k + g < kc) ? A[(size_t)(i + r) * lda + k + g] : 0;
+    }
+}
+
+// Copy a kc x nc block of B into GEMM_NR-column micro-panels, the G values
+// of one column in a k group next to each other
+template <typename In>
+void pack_b_grouped(int kc, int nc, const In* B, int ldb, In* packed) {
+    const int G = GemmGroup<In>::value;
+    for (int j = 0; j < nc; j += GEMM_NR) {
+        int nr = std::min(GEMM_NR, nc - j);
+        for (int k = 0; k < kc; k += G)
+            for (int c = 0; c < GEMM_NR; c++)
+                for (int g = 0; g < G; g++)
+                    *packed++ = (c < nr && k + g < kc) ? B[(size_t)(k + g) * ldb + j + c] : 0;
+    }
+}
+
+// Portable C[mr x nr] += Ap * Bp for any input/accumulator pair
+template <typename In, typename Acc>
+void gemm_narrow_micro_kernel(int kc, const In* Ap, const In* Bp, Acc* C, int ldc, int mr, int nr) {
+    const int G = GemmGroup<In>::value;
+    Acc acc[GEMM_MR][GEMM_NR] = {};
+    for (int k = 0; k < kc; k += G) {
+        for (int r = 0; r < GEMM_MR; r++)
+            for (int c = 0; c < GEMM_NR; c++)
+                for (int g = 0; g < G; g++) acc[r][c] += (Acc)Ap[r * G + g] * (Acc)Bp[c * G + g];
+        Ap += GEMM_MR * G;
+        Bp += GEMM_NR * G;
+    }
+    for (int r = 0; r < mr; r++)
+        for (int c = 0; c < nr; c++) C[(size_t)r * ldc + c] += acc[r][c];
+}
+
+#ifdef GEMM_X86
+
+// Shared epilogue: add two 8-lane accumulators per row back into C
+__attribute__((target("avx2")))
+inline void gemm_narrow_store_avx2(__m256i (*acc)[2], int32_t* C, int ldc, int mr, int nr) {
+    if (mr == GEMM_MR && nr == GEMM_NR) {
+        for (int r = 0; r < GEMM_MR; r++) {
+            __m256i* row = (__m256i*)(C + (size_t)r * ldc);
+            _mm256_storeu_si256(row + 0, _mm256_add_epi32(_mm256_loadu_si256(row + 0), acc[r][0]));
+            _mm256_storeu_si256(row + 1, _mm256_add_epi32(_mm256_loadu_si256(row + 1), acc[r][1]));
+        }
+        return;
+    }
+    int tile[GEMM_MR * GEMM_NR];
+    for (int r = 0; r < GEMM_MR; r++) {
+        _mm256_storeu_si256((__m256i*)(tile + r * GEMM_NR), acc[r][0]);
+        _mm256_storeu_si256((__m256i*)(tile + r * GEMM_NR + 8), acc[r][1]);
+    }
+    gemm_tile_add(tile, C, ldc, mr, nr);
+}
+
+// int16 pairs: vpmaddwd gives a0*b0 + a1*b1 per 32-bit lane
+__attribute__((target("avx2")))
+inline void gemm_kernel_i16_avx2(int kc, const int16_t* Ap, const int16_t* Bp, int32_t* C, int ldc, int mr, int nr) {
+    __m256i acc[GEMM_MR][2];
+    for (int r = 0; r < GEMM_MR; r++) acc[r][0] = acc[r][1] = _mm256_setzero_si256();
+
+    for (int k = 0; k < kc; k += 2) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(Bp + 0));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(Bp + 16));
+        for (int r = 0; r < GEMM_MR; r++) {
+            int32_t pair;
+            memcpy(&pair, Ap + 2 * r, sizeof(pair));
+            __m256i a = _mm256_set1_epi32(pair);
+            acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(a, b0));
+            acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(a, b1));
+        }
+        Ap += GEMM_MR * 2;
+        Bp += GEMM_NR * 2;
+    }
+    gemm_narrow_store_avx2(acc, C, ldc, mr, nr);
+}
+
+// int8 quads: vpmaddubsw multiplies unsigned A bytes by signed B bytes into
+// int16 pair sums, vpmaddwd against ones widens them to int32. A must lie in
+// [0, 127] so the int16 pair sums cannot saturate (see gemm_narrow_type).
+__attribute__((target("avx2")))
+inline void gemm_kernel_i8_avx2(int kc, const int8_t* Ap, const int8_t* Bp, int32_t* C, int ldc, int mr, int nr) {
+    __m256i acc[GEMM_MR][2];
+    for (int r = 0; r < GEMM_MR; r++) acc[r][0] = acc[r][1] = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    for (int k = 0; k < kc; k += 4) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(Bp + 0));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(Bp + 32));
+        for (int r = 0; r < GEMM_MR; r++) {
+            int32_t quad;
+            memcpy(&quad, Ap + 4 * r, sizeof(quad));
+            __m256i a = _mm256_set1_epi32(quad);
+            acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(_mm256_maddubs_epi16(a, b0), ones));
+            acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(_mm256_maddubs_epi16(a, b1), ones));
+        }
+        Ap += GEMM_MR * 4;
+        Bp += GEMM_NR * 4;
+    }
+    gemm_narrow_store_avx2(acc, C, ldc, mr, nr);
+}
+
+#endif
+
+// Micro-kernel for an input/accumulator pair: AVX2 for int8/int16 -> int32
+// when the dispatched ISA allows it, the portable template otherwise
+template <typename In, typename Acc>
+struct GemmNarrowKernel {
+    typedef void (*fn)(int kc, const In* Ap, const In* Bp, Acc* C, int ldc, int mr, int nr);
+    static fn get() { return gemm_narrow_micro_kernel<In, Acc>; }
+};
+
+#ifdef GEMM_X86
+template <>
+struct GemmNarrowKernel<int8_t, int32_t> {
+    typedef void (*fn)(int kc, const int8_t* Ap, const int8_t* Bp, int32_t* C, int ldc, int mr, int nr);
+    static fn get() {
+        return gemm_active_isa() >= ISA_AVX2 ? gemm_kernel_i8_avx2 : gemm_narrow_micro_kernel<int8_t, int32_t>;
+    }
+};
+
+template <>
+struct GemmNarrowKernel<int16_t, int32_t> {
+    typedef void (*fn)(int kc, const int16_t* Ap, const int16_t* Bp, int32_t* C, int ldc, int mr, int nr);
+    static fn get() {
+        return gemm_active_isa() >= ISA_AVX2 ? gemm_kernel_i16_avx2 : gemm_narrow_micro_kernel<int16_t, int32_t>;
+    }
+};
+#endif
+
+// Cache-blocked C += A * B with In inputs and Acc results, same layout and
+// threading rules as gemm_blocked
+template <typename In, typename Acc>
+void gemm_narrow(int M, int N, int K, const In* A, int lda, const In* B, int ldb, Acc* C, int ldc) {
+    const int G = GemmGroup<In>::value;
+    static thread_local std::vector<In> packedA, packedB;
+    packedA.resize((size_t)GEMM_MC * (GEMM_KC + G));
+    packedB.resize((size_t)(GEMM_KC + G) * (GEMM_NC + GEMM_NR));
+    typename GemmNarrowKernel<In, Acc>::fn kernel = GemmNarrowKernel<In, Acc>::get();
+
+    for (int jc = 0; jc < N; jc += GEMM_NC) {
+        int nc = std::min(GEMM_NC, N - jc);
+        for (int pc = 0; pc < K; pc += GEMM_KC) {
+            int kc = std::min(GEMM_KC, K - pc);
+            int kg = (kc + G - 1) / G * G;  // kc padded to whole groups
+            pack_b_grouped(kc, nc, B + (size_t)pc * ldb + jc, ldb, packedB.data());
+
+            for (int ic = 0; ic < M; ic += GEMM_MC) {
+                int mc = std::min(GEMM_MC, M - ic);
+                pack_a_grouped(mc, kc, A + (size_t)ic * lda + pc, lda, packedA.data());
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    int nr = std::min(GEMM_NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        int mr = std::min(GEMM_MR, mc - ir);
+                        kernel(kg, packedA.data() + (size_t)ir * kg, packedB.data() + (size_t)jr * kg,
+                               C + (size_t)(ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Narrowest input type the data fits in without changing any result, or
+// NARROW_OVERFLOW when even an int32 accumulator could overflow
+enum NarrowType { NARROW_INT8, NARROW_INT16, NARROW_INT32, NARROW_OVERFLOW };
+
+inline const char* narrow_type_name(NarrowType type) {
+    static const char* names[] = { "int8", "int16", "int32", "overflow" };
+    return names[type];
+}
+
+// int8 needs A in [0, 127] (vpmaddubsw treats A as unsigned and saturates
+// its int16 pair sums; 2 * 127 * 128 still fits). int16 excludes -32768 so a
+// vpmaddwd pair sum cannot reach 2^31. Returns NARROW_OVERFLOW when K
+// products of the largest magnitudes could exceed INT_MAX: no int32 result,
+// narrow or not, is exact then, and the caller must refuse the inputs.
+inline NarrowType gemm_narrow_type(int minA, int maxA, int minB, int maxB, int K) {
+    long long maxAbsA = std::max(std::llabs(minA), std::llabs(maxA));
+    long long maxAbsB = std::max(std::llabs(minB), std::llabs(maxB));
+    // maxAbsA * maxAbsB * K > INT_MAX, by division: the product itself can
+    // overflow long long for magnitudes near INT_MAX
+    if (K > 0 && maxAbsA > INT_MAX / std::max(maxAbsB, 1LL) / K) return NARROW_OVERFLOW;
+    if (minA >= 0 && maxA <= 127 && minB >= -128 && maxB <= 127) return NARROW_INT8;
+    if (minA > SHRT_MIN && maxA <= SHRT_MAX && minB > SHRT_MIN && maxB <= SHRT_MAX) return NARROW_INT16;
+    return NARROW_INT32;
+}
+
+inline NarrowType gemm_narrow_type(const int* A, size_t sizeA, const int* B, size_t sizeB, int K) {
+    if (sizeA == 0 || sizeB == 0) return NARROW_INT8;
+    auto a = std::minmax_element(A, A + sizeA);
+    auto b = std::minmax_element(B, B + sizeB);
+    return gemm_narrow_type(*a.first, *a.second, *b.first, *b.second, K);
+}
+
+// Convert int32 data to a narrower type already checked by gemm_narrow_type
+template <typename In>
+std::vector<In> narrow_copy(const int* data, size_t count) {
+    return std::vector<In>(data, data + count);
+}
+
+#endif
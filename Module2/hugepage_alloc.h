@@ -0,0 +1,79 @@
+#ifndef HUGEPAGE_ALLOC_H
+#define HUGEPAGE_ALLOC_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+// Buffers for bandwidth-bound loops over hundreds of MB. With 4 KiB pages a
+// 400 MB array spans 100k pages and a streaming loop misses the TLB on every
+// page; 2 MiB pages cut that 512-fold. Explicit huge pages (MAP_HUGETLB) are
+// used when the administrator has reserved them (vm.nr_hugepages), otherwise
+// the mapping is 2 MiB aligned and marked MADV_HUGEPAGE so transparent huge
+// pages back it. Every buffer is at least 64-byte (cache line) aligned.
+//
+// HUGEPAGES=off in the environment skips both and maps ordinary pages.
+
+const size_t HUGEPAGE_SIZE = 2 << 20;
+
+enum HugePageKind { HUGEPAGE_NONE, HUGEPAGE_TRANSPARENT, HUGEPAGE_EXPLICIT };
+
+inline const char* hugepage_kind_name(HugePageKind kind) {
+    static const char* names[] = { "4 KiB pages", "transparent 2 MiB pages", "explicit 2 MiB pages" };
+    return names[kind];
+}
+
+inline size_t hugepage_round(size_t bytes) {
+    return (bytes + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+}
+
+// `bytes` of zero-filled memory, or nullptr. `kind` (optional) reports what
+// backs it; the transparent case is a request the kernel may still decline.
+// Release with hugepage_free and the same byte count.
+inline void* hugepage_alloc(size_t bytes, HugePageKind* kind = nullptr) {
+    size_t length = hugepage_round(bytes);
+    const char* env = getenv("HUGEPAGES");
+    bool enabled = !(env && strcmp(env, "off") == 0);
+
+#ifdef MAP_HUGETLB
+    if (enabled) {
+        void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            if (kind) *kind = HUGEPAGE_EXPLICIT;
+            return p;
+        }
+    }
+#endif
+
+    // Over-map by one huge page and trim both ends to a 2 MiB aligned range,
+    // since only aligned 2 MiB extents can become huge pages
+    char* raw = (char*)mmap(NULL, length + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    char* p = (char*)(((size_t)raw + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE);
+    if (p > raw) munmap(raw, p - raw);
+    munmap(p + length, raw + HUGEPAGE_SIZE - p);
+
+    HugePageKind got = HUGEPAGE_NONE;
+#ifdef MADV_HUGEPAGE
+    if (enabled && madvise(p, length, MADV_HUGEPAGE) == 0) got = HUGEPAGE_TRANSPARENT;
+#endif
+    if (kind) *kind = got;
+    return p;
+}
+
+inline void hugepage_free(void* p, size_t bytes) {
+    if (p) munmap(p, hugepage_round(bytes));
+}
+
+template <typename T>
+T* hugepage_alloc_array(size_t count, HugePageKind* kind = nullptr) {
+    return (T*)hugepage_alloc(count * sizeof(T), kind);
+}
+
+template <typename T>
+void hugepage_free_array(T* p, size_t count) {
+    hugepage_free(p, count * sizeof(T));
+}
+
+#endif
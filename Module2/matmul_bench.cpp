@@ -0,0 +1,252 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <omp.h>
+#include <mpi.h>
+#include "matrix.h"
+#include "strassen.h"
+#include "gemm_fixed.h"
+#include "backend.h"
+#include "counter_rng.h"
+
+// Benchmark driver for the matrix multiplication backends.
+//
+//   mpirun -np 4 ./matmul_bench --sizes 512,1024,2048 --threads 1,2,4,8
+//       --backends seq,dispatch,pthreads,openmp,strassen,mpi,mpi+openmp,mpi+pthreads
+//       --warmup 2 --samples 10 --cutoff 512
+//
+// "dispatch" is gemm_dispatch on one thread: the fixed-size kernel for sizes
+// in GemmFixedSquareSizes (100 among the defaults), gemm_blocked for the rest.
+// seq, pthreads and openmp (and the local rows of their MPI variants) run on
+// the executors of backend.h. Single-node backends run on rank 0 only; the
+// MPI backends use every rank.
+// Each result is checked against the sequential C_seq for the same inputs,
+// and C_seq against a naive triple loop for n <= NAIVE_CHECK_MAX.
+// Output is one CSV row per (backend, N, threads) on rank 0.
+
+using namespace std;
+
+struct BenchConfig {
+    vector<int> sizes = { 100, 256, 512, 1024 };
+    vector<int> threads = { 1, 2, 4 };
+    vector<string> backends = { "seq", "dispatch", "pthreads", "openmp", "strassen", "mpi", "mpi+openmp", "mpi+pthreads" };
+    int warmup = 1;
+    int cutoff = 512;
+    int samples = 5;
+    unsigned seed = 42;
+};
+
+// Multiply rows x n block of A by n x n B into C (overwritten) using `threads` workers
+typedef void (*local_gemm_fn)(const int* A, const int* B, int* C, int rows, int n, int threads);
+
+// seq, pthreads and openmp are the executors of backend.h, one per backend,
+// rebuilt only when the thread count changes (so the Pthreads pool persists)
+void local_executor(Backend backend, const int* A, const int* B, int* C, int rows, int n, int threads) {
+    static std::unique_ptr<Executor> executors[BACKEND_COUNT];
+    std::unique_ptr<Executor>& exec = executors[backend];
+    if (!exec || (backend != BACKEND_SERIAL && exec->threads() != threads)) exec.reset(new Executor(backend, threads));
+    backend_matmul_rows(*exec, A, B, C, rows, n);
+}
+
+void local_sequential(const int* A, const int* B, int* C, int rows, int n, int threads) {
+    local_executor(BACKEND_SERIAL, A, B, C, rows, n, threads);
+}
+
+void local_pthreads(const int* A, const int* B, int* C, int rows, int n, int threads) {
+    local_executor(BACKEND_PTHREADS, A, B, C, rows, n, threads);
+}
+
+void local_openmp(const int* A, const int* B, int* C, int rows, int n, int threads) {
+    local_executor(BACKEND_OPENMP, A, B, C, rows, n, threads);
+}
+
+void local_dispatch(const int* A, const int* B, int* C, int rows, int n, int) {
+    gemm_dispatch(rows, n, n, A, n, B, n, C, n);
+}
+
+int strassen_cutoff = 512;
+
+// Strassen-Winograd over the whole matrix (rows == n)
+void local_strassen(const int* A, const int* B, int* C, int rows, int n, int threads) {
+    Matrix<int> a(rows, n), b(n, n), c(rows, n);
+    memcpy(a.data(), A, sizeof(int) * a.size());
+    memcpy(b.data(), B, sizeof(int) * b.size());
+    strassen_multiply(a, b, c, strassen_cutoff, threads);
+    memcpy(C, c.data(), sizeof(int) * c.size());
+}
+
+// Row-distributed multiply: B is broadcast, rows of A are scattered (the
+// N % ranks leftover rows go to the low ranks), local rows are computed with
+// `local` and C is gathered back to rank 0. A and C are only read/written on rank 0.
+void mpi_multiply(const Matrix<int>& A, Matrix<int>& B, Matrix<int>& C, int n, int threads,
+                  local_gemm_fn local) {
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    vector<int> counts(ranks), displs(ranks);
+    for (int r = 0; r < ranks; r++) {
+        int begin = (long)r * n / ranks, end = (long)(r + 1) * n / ranks;
+        counts[r] = (end - begin) * n;
+        displs[r] = begin * n;
+    }
+    int localRows = counts[rank] / n;
+    vector<int> localA((size_t)localRows * n), localC((size_t)localRows * n);
+
+    MPI_Bcast(B.data(), n * n, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(A.data(), counts.data(), displs.data(), MPI_INT,
+                 localA.data(), counts[rank], MPI_INT, 0, MPI_COMM_WORLD);
+    local(localA.data(), B.data(), localC.data(), localRows, n, threads);
+    MPI_Gatherv(localC.data(), counts[rank], MPI_INT,
+                C.data(), counts.data(), displs.data(), MPI_INT, 0, MPI_COMM_WORLD);
+}
+
+bool is_mpi_backend(const string& backend) { return backend.compare(0, 3, "mpi") == 0; }
+
+// Backends without a thread count are only swept once
+bool uses_threads(const string& backend) {
+    return backend == "pthreads" || backend == "openmp" || backend == "strassen" ||
+           backend == "mpi+openmp" || backend == "mpi+pthreads";
+}
+
+local_gemm_fn local_kernel_for(const string& backend) {
+    if (backend == "pthreads" || backend == "mpi+pthreads") return local_pthreads;
+    if (backend == "openmp" || backend == "mpi+openmp") return local_openmp;
+    if (backend == "strassen") return local_strassen;
+    if (backend == "dispatch") return local_dispatch;
+    return local_sequential;
+}
+
+// Plain triple loop, used to check C_seq itself: every backend shares
+// gemm_blocked, so a kernel bug would otherwise match in all of them
+void gemm_naive(const Matrix<int>& A, const Matrix<int>& B, Matrix<int>& C, int n) {
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) {
+            int sum = 0;
+            for (int k = 0; k < n; k++) sum += A[i][k] * B[k][j];
+            C[i][j] = sum;
+        }
+}
+
+// The naive check is O(n^3) with no blocking, so it only runs up to this size
+const int NAIVE_CHECK_MAX = 512;
+
+// Nearest-rank percentile of an unsorted sample
+double percentile(vector<double> samples, double p) {
+    sort(samples.begin(), samples.end());
+    size_t index = (size_t)(p * samples.size() + 0.999999);
+    return samples[min(samples.size(), max<size_t>(index, 1)) - 1];
+}
+
+template <typename T>
+vector<T> parse_list(const string& text) {
+    vector<T> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        stringstream field(item);
+        T value;
+        if (field >> value) values.push_back(value);
+    }
+    return values;
+}
+
+bool parse_args(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--sizes") config.sizes = parse_list<int>(value);
+        else if (arg == "--threads") config.threads = parse_list<int>(value);
+        else if (arg == "--backends") config.backends = parse_list<string>(value);
+        else if (arg == "--warmup") config.warmup = atoi(value.c_str());
+        else if (arg == "--samples") config.samples = atoi(value.c_str());
+        else if (arg == "--cutoff") config.cutoff = atoi(value.c_str());
+        else if (arg == "--seed") config.seed = strtoul(value.c_str(), NULL, 10);
+        else return false;
+    }
+    return !config.sizes.empty() && !config.threads.empty() && !config.backends.empty() && config.samples > 0;
+}
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    BenchConfig config;
+    if (!parse_args(argc, argv, config)) {
+        if (rank == 0)
+            cerr << "usage: " << argv[0] << " [--sizes N,...] [--threads T,...] [--backends b,...]"
+                 << " [--warmup W] [--samples S] [--cutoff C] [--seed X]\n"
+                 << "backends: seq dispatch pthreads openmp strassen mpi mpi+openmp mpi+pthreads\n";
+        MPI_Finalize();
+        return 1;
+    }
+
+    strassen_cutoff = config.cutoff;
+    if (rank == 0) cout << "backend,n,threads,ranks,isa,samples,median_ms,p95_ms,gops,verified" << endl;
+    int failures = 0;
+
+    for (int n : config.sizes) {
+        // Every rank needs B for the MPI backends; A, C and C_seq live on rank 0
+        Matrix<int> A, B(n, n), C, C_seq;
+        if (rank == 0) {
+            A.resize(n, n);
+            C.resize(n, n);
+            C_seq.resize(n, n);
+            for (int i = 0; i < n; i++) {
+                counter_rng_fill(A[i], n, (size_t)i * n, counter_rng_stream(config.seed, 0), 10);
+                counter_rng_fill(B[i], n, (size_t)i * n, counter_rng_stream(config.seed, 1), 10);
+            }
+            gemm_rows(A, B, C_seq, 0, n);
+            if (n <= NAIVE_CHECK_MAX) {
+                gemm_naive(A, B, C, n);
+                if (memcmp(C.data(), C_seq.data(), C_seq.size() * sizeof(int)) != 0) {
+                    cerr << "n=" << n << ": gemm_blocked reference differs from the naive triple loop" << endl;
+                    failures++;
+                }
+            }
+        }
+
+        for (const string& backend : config.backends) {
+            bool distributed = is_mpi_backend(backend);
+            local_gemm_fn local = local_kernel_for(backend);
+            vector<int> sweep = uses_threads(backend) ? config.threads : vector<int>{ 1 };
+
+            for (int threads : sweep) {
+                vector<double> samples;
+                for (int run = 0; run < config.warmup + config.samples; run++) {
+                    MPI_Barrier(MPI_COMM_WORLD);
+                    double start = MPI_Wtime();
+                    if (distributed) mpi_multiply(A, B, C, n, threads, local);
+                    else if (rank == 0) local(A.data(), B.data(), C.data(), n, n, threads);
+                    MPI_Barrier(MPI_COMM_WORLD);
+                    double elapsed = MPI_Wtime() - start;
+                    if (run >= config.warmup) samples.push_back(elapsed * 1e3);
+                }
+
+                if (rank == 0) {
+                    bool verified = memcmp(C.data(), C_seq.data(), C_seq.size() * sizeof(int)) == 0;
+                    if (!verified) failures++;
+                    double median = percentile(samples, 0.5);
+                    double p95 = percentile(samples, 0.95);
+                    double gops = 2.0 * n * n * n / (median * 1e-3) / 1e9;
+                    cout << backend << "," << n << "," << threads << "," << (distributed ? ranks : 1) << ","
+                         << gemm_isa_name(gemm_active_isa()) << "," << samples.size() << ","
+                         << median << "," << p95 << "," << gops << "," << (verified ? "ok" : "FAIL") << endl;
+                }
+                if (rank == 0) C.fill(-1);
+            }
+        }
+    }
+
+    MPI_Bcast(&failures, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,150 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "gemm_kernels.h"
+
+// Contiguous row-major matrix. Rows are laid out back to back in a single
+// 64-byte aligned allocation, so M[i][j] is one address computation instead
+// of a pointer chase through a separate heap block per row.
+template <typename T>
+class Matrix {
+public:
+    Matrix() : rows_(0), cols_(0), data_(nullptr) {}
+
+    Matrix(int rows, int cols) : rows_(0), cols_(0), data_(nullptr) {
+        resize(rows, cols);
+    }
+
+    ~Matrix() { free(data_); }
+
+    Matrix(const Matrix&) = delete;
+    Matrix& operator=(const Matrix&) = delete;
+
+    Matrix(Matrix&& other) noexcept
+        : rows_(other.rows_), cols_(other.cols_), data_(other.data_) {
+        other.rows_ = other.cols_ = 0;
+        other.data_ = nullptr;
+    }
+
+    Matrix& operator=(Matrix&& other) noexcept {
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(data_, other.data_);
+        return *this;
+    }
+
+    // Reallocate to rows x cols and zero every element. With zero = false the
+    // pages are left untouched, so the threads that will use each part can
+    // write it first and have it placed on their own NUMA node.
+    void resize(int rows, int cols, bool zero = true) {
+        free(data_);
+        data_ = nullptr;
+        rows_ = rows;
+        cols_ = cols;
+        size_t bytes = size() * sizeof(T);
+        if (bytes == 0) return;
+        if (posix_memalign((void**)&data_, 64, bytes) != 0) throw std::bad_alloc();
+        if (zero) memset(data_, 0, bytes);
+    }
+
+    void fill(T value) { std::fill(data_, data_ + size(), value); }
+
+    T* operator[](int row) { return data_ + (size_t)row * cols_; }
+    const T* operator[](int row) const { return data_ + (size_t)row * cols_; }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    size_t size() const { return (size_t)rows_ * cols_; }
+
+private:
+    int rows_, cols_;
+    T* data_;
+};
+
+// Copy an mc x kc block of A into micro-panels of GEMM_MR rows stored
+// k-major, zero-padding the last panel so the micro-kernel never branches
+template <typename T>
+void pack_a(int mc, int kc, const T* A, int lda, T* packed) {
+    for (int i = 0; i < mc; i += GEMM_MR) {
+        int mr = std::min(GEMM_MR, mc - i);
+        for (int k = 0; k < kc; k++) {
+            for (int r = 0; r < mr; r++) packed[r] = A[(size_t)(i + r) * lda + k];
+            for (int r = mr; r < GEMM_MR; r++) packed[r] = 0;
+            packed += GEMM_MR;
+        }
+    }
+}
+
+// Copy a kc x nc block of B into micro-panels of GEMM_NR columns stored
+// k-major, zero-padding the last panel
+template <typename T>
+void pack_b(int kc, int nc, const T* B, int ldb, T* packed) {
+    for (int j = 0; j < nc; j += GEMM_NR) {
+        int nr = std::min(GEMM_NR, nc - j);
+        for (int k = 0; k < kc; k++) {
+            const T* row = B + (size_t)k * ldb + j;
+            for (int c = 0; c < nr; c++) packed[c] = row[c];
+            for (int c = nr; c < GEMM_NR; c++) packed[c] = 0;
+            packed += GEMM_NR;
+        }
+    }
+}
+
+// Cache-blocked C += A * B where A is M x K, B is K x N and C is M x N, all
+// row-major with the given leading dimensions. Packing buffers are per thread,
+// so disjoint row ranges of C may be computed concurrently.
+template <typename T>
+void gemm_blocked(int M, int N, int K, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+    static thread_local std::vector<T> packedA, packedB;
+    packedA.resize((size_t)GEMM_MC * GEMM_KC);
+    packedB.resize((size_t)GEMM_KC * (GEMM_NC + GEMM_NR));
+    typename GemmKernel<T>::fn kernel = GemmKernel<T>::get();
+
+    for (int jc = 0; jc < N; jc += GEMM_NC) {
+        int nc = std::min(GEMM_NC, N - jc);
+        for (int pc = 0; pc < K; pc += GEMM_KC) {
+            int kc = std::min(GEMM_KC, K - pc);
+            pack_b(kc, nc, B + (size_t)pc * ldb + jc, ldb, packedB.data());
+
+            for (int ic = 0; ic < M; ic += GEMM_MC) {
+                int mc = std::min(GEMM_MC, M - ic);
+                pack_a(mc, kc, A + (size_t)ic * lda + pc, lda, packedA.data());
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    int nr = std::min(GEMM_NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        int mr = std::min(GEMM_MR, mc - ir);
+                        kernel(kc, packedA.data() + (size_t)ir * kc,
+                               packedB.data() + (size_t)jr * kc,
+                               C + (size_t)(ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Rows per dynamically scheduled chunk: about four chunks per thread for load
+// balance, but never so few rows that re-packing B for each chunk dominates
+inline int gemm_row_chunk(int rows, int threads) {
+    int chunk = rows / (4 * (threads > 0 ? threads : 1));
+    chunk = (chunk + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+    return std::max(16, std::min(GEMM_MC, chunk));
+}
+
+// Compute rows [row_begin, row_end) of C += A * B
+template <typename T>
+void gemm_rows(const Matrix<T>& A, const Matrix<T>& B, Matrix<T>& C, int row_begin, int row_end) {
+    if (row_end <= row_begin) return;
+    gemm_blocked(row_end - row_begin, B.cols(), A.cols(),
+                 A[row_begin], A.cols(), B.data(), B.cols(), C[row_begin], C.cols());
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary matrix file: a fixed header padded to one 4 KiB page, then the
+// elements row-major with no separators. Loading maps the file read-only, so
+// the data is used straight from the page cache (no parse, no copy) and the
+// first element is page-aligned. Writing is header + one bulk write.
+//
+//   offset 0     MatrixHeader (magic "SITMAT01", element type, rows, cols)
+//   offset 4096  rows * cols elements of the stated type
+
+const size_t MATRIX_FILE_DATA_OFFSET = 4096;
+
+enum MatrixElementType : uint32_t { MATRIX_INT8 = 1, MATRIX_INT16 = 2, MATRIX_INT32 = 3, MATRIX_FLOAT = 4, MATRIX_DOUBLE = 5 };
+
+struct MatrixHeader {
+    char magic[8];        // "SITMAT01"
+    uint32_t type;        // MatrixElementType
+    uint32_t elem_size;   // bytes per element
+    uint64_t rows, cols;
+    uint64_t data_offset;  // MATRIX_FILE_DATA_OFFSET
+};
+
+template <typename T> struct MatrixTypeCode;
+template <> struct MatrixTypeCode<int8_t> { static const uint32_t value = MATRIX_INT8; };
+template <> struct MatrixTypeCode<int16_t> { static const uint32_t value = MATRIX_INT16; };
+template <> struct MatrixTypeCode<int32_t> { static const uint32_t value = MATRIX_INT32; };
+template <> struct MatrixTypeCode<float> { static const uint32_t value = MATRIX_FLOAT; };
+template <> struct MatrixTypeCode<double> { static const uint32_t value = MATRIX_DOUBLE; };
+
+template <typename T>
+MatrixHeader matrix_header(uint64_t rows, uint64_t cols) {
+    MatrixHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SITMAT01", 8);
+    header.type = MatrixTypeCode<T>::value;
+    header.elem_size = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    header.data_offset = MATRIX_FILE_DATA_OFFSET;
+    return header;
+}
+
+// Checks a header read from a file of `file_size` bytes against element type T
+template <typename T>
+bool matrix_header_valid(const MatrixHeader& header, uint64_t file_size) {
+    return memcmp(header.magic, "SITMAT01", 8) == 0 && header.type == MatrixTypeCode<T>::value &&
+           header.elem_size == sizeof(T) && header.data_offset >= sizeof(MatrixHeader) &&
+           file_size >= header.data_offset + header.rows * header.cols * sizeof(T);
+}
+
+// Read-only view of a matrix file. The mapping lives as long as the object.
+template <typename T>
+class MappedMatrix {
+public:
+    MappedMatrix() : base_(nullptr), length_(0) { memset(&header_, 0, sizeof(header_)); }
+    ~MappedMatrix() { close(); }
+
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    // Map `path`; on failure prints the reason and returns false
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return fail(path, strerror(errno));
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MatrixHeader)) {
+            ::close(fd);
+            return fail(path, "too short for a matrix header");
+        }
+        void* base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // The mapping keeps the file open
+        if (base == MAP_FAILED) return fail(path, strerror(errno));
+
+        memcpy(&header_, base, sizeof(header_));
+        if (!matrix_header_valid<T>(header_, info.st_size)) {
+            munmap(base, info.st_size);
+            return fail(path, "not a matrix file of the expected element type");
+        }
+        base_ = (char*)base;
+        length_ = info.st_size;
+        madvise(base_, length_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close() {
+        if (base_) munmap(base_, length_);
+        base_ = nullptr;
+        length_ = 0;
+    }
+
+    const T* data() const { return (const T*)(base_ + header_.data_offset); }
+    const T* operator[](size_t row) const { return data() + row * header_.cols; }
+    size_t rows() const { return header_.rows; }
+    size_t cols() const { return header_.cols; }
+
+private:
+    bool fail(const char* path, const char* reason) {
+        fprintf(stderr, "%s: %s\n", path, reason);
+        return false;
+    }
+
+    MatrixHeader header_;
+    char* base_;
+    size_t length_;
+};
+
+// write() until every byte is out; returns false on error
+inline bool matrix_write_all(int fd, const void* data, size_t bytes) {
+    const char* p = (const char*)data;
+    while (bytes > 0) {
+        ssize_t n = write(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+// Write a rows x cols row-major matrix (leading dimension `ld`) to `path`.
+// Goes through a temporary file and rename, so readers never see half a file.
+template <typename T>
+bool matrix_write(const char* path, const T* data, size_t rows, size_t cols, size_t ld) {
+    std::string tmp = std::string(path) + ".tmp." + std::to_string((long)getpid());
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    char page[MATRIX_FILE_DATA_OFFSET] = {};
+    MatrixHeader header = matrix_header<T>(rows, cols);
+    memcpy(page, &header, sizeof(header));
+    bool ok = matrix_write_all(fd, page, sizeof(page));
+    if (ld == cols) {
+        ok = ok && matrix_write_all(fd, data, rows * cols * sizeof(T));
+    } else {
+        for (size_t i = 0; ok && i < rows; i++) ok = matrix_write_all(fd, data + i * ld, cols * sizeof(T));
+    }
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool matrix_write(const char* path, const T* data, size_t rows, size_t cols) {
+    return matrix_write(path, data, rows, cols, cols);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef MATRIX_IO_MPI_H
+#define MATRIX_IO_MPI_H
+
+#include <cstdio>
+#include <mpi.h>
+#include "matrix_io.h"
+
+// Parallel access to matrix_io.h files with MPI-IO. Every rank reads or
+// writes only its own row range, straight between the file and its local
+// buffer, so nothing funnels through rank 0.
+
+template <typename T> MPI_Datatype matrix_mpi_type();
+template <> inline MPI_Datatype matrix_mpi_type<int8_t>() { return MPI_INT8_T; }
+template <> inline MPI_Datatype matrix_mpi_type<int16_t>() { return MPI_INT16_T; }
+template <> inline MPI_Datatype matrix_mpi_type<int32_t>() { return MPI_INT32_T; }
+template <> inline MPI_Datatype matrix_mpi_type<float>() { return MPI_FLOAT; }
+template <> inline MPI_Datatype matrix_mpi_type<double>() { return MPI_DOUBLE; }
+
+// Read a file's header on every rank of `comm` (collective). Returns false on
+// every rank if the file is missing or not a T matrix.
+template <typename T>
+bool matrix_read_header_mpi(const char* path, MatrixHeader& header, MPI_Comm comm) {
+    MPI_File file;
+    if (MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        if (rank == 0) fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    MPI_Offset size;
+    MPI_File_get_size(file, &size);
+    MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    return (size_t)size >= sizeof(header) && matrix_header_valid<T>(header, size);
+}
+
+// Rows [first_row, first_row + rows) of the matrix in `path` into `out`
+// (collective; ranks may ask for different or empty ranges). Rows are read
+// as one contiguous row type, so counts stay small for multi-GB files. A
+// range past the end on any rank fails the call on every rank.
+template <typename T>
+bool matrix_read_rows_mpi(const char* path, size_t first_row, size_t rows, T* out, MPI_Comm comm) {
+    MatrixHeader header;
+    if (!matrix_read_header_mpi<T>(path, header, comm)) return false;
+    // Agree on the range check first: a rank returning on its own would
+    // leave the others blocked in the collective open below
+    int outside = first_row + rows > header.rows, anyOutside = 0;
+    MPI_Allreduce(&outside, &anyOutside, 1, MPI_INT, MPI_LOR, comm);
+    if (anyOutside) {
+        if (outside) fprintf(stderr, "%s: rows [%zu, %zu) past the %zu rows in the file\n", path, first_row,
+                             first_row + rows, (size_t)header.rows);
+        return false;
+    }
+
+    MPI_File file;
+    MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    MPI_Datatype row;
+    MPI_Type_contiguous((int)header.cols, matrix_mpi_type<T>(), &row);
+    MPI_Type_commit(&row);
+    MPI_Offset offset = header.data_offset + (MPI_Offset)first_row * header.cols * sizeof(T);
+    int status = MPI_File_read_at_all(file, offset, out, (int)rows, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&row);
+    MPI_File_close(&file);
+    return status == MPI_SUCCESS;
+}
+
+// Write a total_rows x cols matrix where each rank supplies its rows starting
+// at first_row (collective). Rank 0 also writes the header.
+template <typename T>
+bool matrix_write_rows_mpi(const char* path, size_t total_rows, size_t cols, size_t first_row, size_t rows,
+                           const T* data, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_File file;
+    if (MPI_File_open(comm, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "%s: cannot create\n", path);
+        return false;
+    }
+    MatrixHeader header = matrix_header<T>(total_rows, cols);
+    MPI_File_set_size(file, header.data_offset + total_rows * cols * sizeof(T));
+    if (rank == 0) MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+
+    MPI_Datatype row;
+    MPI_Type_contiguous((int)cols, matrix_mpi_type<T>(), &row);
+    MPI_Type_commit(&row);
+    MPI_Offset offset = header.data_offset + (MPI_Offset)first_row * cols * sizeof(T);
+    int status = MPI_File_write_at_all(file, offset, data, (int)rows, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&row);
+    MPI_File_close(&file);
+    return status == MPI_SUCCESS;
+}
+
+#endif
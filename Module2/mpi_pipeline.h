@@ -0,0 +1,120 @@
+#ifndef MPI_PIPELINE_H
+#define MPI_PIPELINE_H
+
+#include <algorithm>
+#include <vector>
+#include <mpi.h>
+#include "row_distribution.h"
+
+// Pipelined row-distributed multiply. Each rank's rows of A are split into
+// `panels` row panels. Panel p + 1 is scattered with MPI_Iscatterv while
+// panel p is multiplied. The result of panel p is returned with MPI_Igatherv
+// while later panels are still computing. Every row of C needs all of B,
+// so B is not pipelined: its MPI_Ibcast only runs alongside the scatter of
+// panel 0, and the rest of its transfer is waited for (and counted in
+// comm_wait) before the first panel is computed.
+//
+// Many MPI libraries only progress non-blocking collectives from inside MPI
+// calls. Panels are therefore computed in slices of `progress_rows`, with an
+// MPI_Testall on the outstanding requests after each slice.
+
+struct PipelineTimes {
+    double total;      // End-to-end wall clock, first post to last completion
+    double comm_wait;  // Time blocked in MPI_Wait* for data that was not there yet
+    double compute;    // Time inside the local kernel
+};
+
+// Rows [begin, end) of this rank's local block that make up panel p
+inline void pipeline_panel_range(int local_rows, int panels, int p, int& begin, int& end) {
+    begin = (int)((long)p * local_rows / panels);
+    end = (int)((long)(p + 1) * local_rows / panels);
+}
+
+// Scatterv/Gatherv layout of panel p across all ranks
+inline RowDistribution pipeline_panel_distribution(const RowDistribution& rows, int panels, int p) {
+    int ranks = (int)rows.counts.size();
+    RowDistribution panel;
+    panel.row_width = rows.row_width;
+    for (int r = 0; r < ranks; r++) {
+        int begin, end;
+        pipeline_panel_range(rows.rows(r), panels, p, begin, end);
+        panel.counts.push_back((end - begin) * rows.row_width);
+        panel.displs.push_back((rows.first_row(r) + begin) * rows.row_width);
+    }
+    return panel;
+}
+
+// A and C are the full N x N matrices (only read/written on root); B must be
+// N x N on every rank; localA/localC hold this rank's rows. kernel(A, C, r)
+// must overwrite r rows of C with A * B.
+template <typename Kernel>
+PipelineTimes pipelined_multiply(const int* A, int* B, int* C, int n, const RowDistribution& rows,
+                                 int* localA, int* localC, int panels, int progress_rows,
+                                 Kernel kernel, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    panels = std::max(panels, 1);
+    progress_rows = std::max(progress_rows, 1);
+    int localRows = rows.rows(rank);
+
+    std::vector<RowDistribution> layout;
+    for (int p = 0; p < panels; p++) layout.push_back(pipeline_panel_distribution(rows, panels, p));
+
+    PipelineTimes times = { 0, 0, 0 };
+    double start = MPI_Wtime();
+
+    // B and panel 0 in flight together; no panel can start without all of B
+    MPI_Request bcast, scatter[2];
+    std::vector<MPI_Request> gathers;
+    MPI_Ibcast(B, n * n, MPI_INT, 0, comm, &bcast);
+
+    auto post_scatter = [&](int p, MPI_Request* req) {
+        int begin, end;
+        pipeline_panel_range(localRows, panels, p, begin, end);
+        MPI_Iscatterv(A, layout[p].counts.data(), layout[p].displs.data(), MPI_INT,
+                      localA + (size_t)begin * n, layout[p].counts[rank], MPI_INT, 0, comm, req);
+    };
+    auto wait = [&](MPI_Request* req) {
+        double t = MPI_Wtime();
+        MPI_Wait(req, MPI_STATUS_IGNORE);
+        times.comm_wait += MPI_Wtime() - t;
+    };
+
+    post_scatter(0, &scatter[0]);
+    wait(&bcast);
+
+    for (int p = 0; p < panels; p++) {
+        MPI_Request* current = &scatter[p % 2];
+        MPI_Request* next = &scatter[(p + 1) % 2];
+        if (p + 1 < panels) post_scatter(p + 1, next);
+        wait(current);
+
+        int begin, end;
+        pipeline_panel_range(localRows, panels, p, begin, end);
+        for (int row = begin; row < end; row += progress_rows) {
+            int slice = std::min(progress_rows, end - row);
+            double t = MPI_Wtime();
+            kernel(localA + (size_t)row * n, localC + (size_t)row * n, slice);
+            times.compute += MPI_Wtime() - t;
+
+            // Give the library a chance to move the in-flight panels along
+            int flag;
+            if (p + 1 < panels) MPI_Test(next, &flag, MPI_STATUS_IGNORE);
+            if (!gathers.empty()) MPI_Testall((int)gathers.size(), gathers.data(), &flag, MPI_STATUSES_IGNORE);
+        }
+
+        MPI_Request gather;
+        MPI_Igatherv(localC + (size_t)begin * n, layout[p].counts[rank], MPI_INT,
+                     C, layout[p].counts.data(), layout[p].displs.data(), MPI_INT, 0, comm, &gather);
+        gathers.push_back(gather);
+    }
+
+    double t = MPI_Wtime();
+    MPI_Waitall((int)gathers.size(), gathers.data(), MPI_STATUSES_IGNORE);
+    times.comm_wait += MPI_Wtime() - t;
+
+    times.total = MPI_Wtime() - start;
+    return times;
+}
+
+#endif
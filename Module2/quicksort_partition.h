@@ -0,0 +1,77 @@
+#ifndef QUICKSORT_PARTITION_H
+#define QUICKSORT_PARTITION_H
+
+#include <utility>
+#include <vector>
+
+// Building blocks shared by the parallel quicksorts (M2_T2C_2 on the
+// work-stealing scheduler, M2_T2C_3 on OpenMP tasks). Ranges are inclusive,
+// [low, high], as the sorts pass them.
+
+// Ranges at or below this size are finished with insertion sort
+const int INSERTION_CUTOFF = 24;
+
+inline void insertionSort(std::vector<int>& vec, int low, int high) {
+    for (int i = low + 1; i <= high; ++i) {
+        int key = vec[i];
+        int j = i - 1;
+        while (j >= low && vec[j] > key) {
+            vec[j + 1] = vec[j];
+            --j;
+        }
+        vec[j + 1] = key;
+    }
+}
+
+// Index of the median of vec[a], vec[b], vec[c]
+inline int medianOf3(const std::vector<int>& vec, int a, int b, int c) {
+    if (vec[a] < vec[b]) return vec[b] < vec[c] ? b : (vec[a] < vec[c] ? c : a);
+    return vec[a] < vec[c] ? a : (vec[b] < vec[c] ? c : b);
+}
+
+// Median of three for short ranges, Tukey's ninther (median of three
+// medians) for long ones. Sorted, reversed and organ-pipe inputs all give a
+// pivot near the middle instead of the Lomuto vec[high] worst case. The end
+// elements are not sampled: partition3 leaves the old vec[low] at one end of
+// a side, and on reversed input that is the side's largest key.
+inline int choosePivot(const std::vector<int>& vec, int low, int high) {
+    low++;
+    high--;
+    int mid = low + (high - low) / 2;
+    if (high - low < 1024) return medianOf3(vec, low, mid, high);
+    int step = (high - low) / 8;
+    return medianOf3(vec, medianOf3(vec, low, low + step, low + 2 * step),
+                     medianOf3(vec, mid - step, mid, mid + step),
+                     medianOf3(vec, high - 2 * step, high - step, high));
+}
+
+// Three-way partition around vec[pivotIndex]: afterwards [low, lt) < pivot,
+// [lt, gt] == pivot and (gt, high] > pivot. The equal block is never
+// revisited, so heavy duplicates (0-999 in millions of keys) shrink the
+// problem instead of unbalancing it. This is the Bentley-McIlroy form of the
+// Dutch flag partition: it scans from both ends like Hoare's, parks keys
+// equal to the pivot at the two ends and swaps them into the middle at the
+// end, so input that is already in order is barely moved.
+inline void partition3(std::vector<int>& vec, int low, int high, int pivotIndex, int& lt, int& gt) {
+    std::swap(vec[low], vec[pivotIndex]);
+    int pivot = vec[low];
+    int i = low, j = high + 1, p = low, q = high + 1;
+    for (;;) {
+        while (vec[++i] < pivot)
+            if (i == high) break;
+        while (pivot < vec[--j])
+            if (j == low) break;
+        if (i == j && vec[i] == pivot) std::swap(vec[++p], vec[i]);
+        if (i >= j) break;
+        std::swap(vec[i], vec[j]);
+        if (vec[i] == pivot) std::swap(vec[++p], vec[i]);
+        if (vec[j] == pivot) std::swap(vec[--q], vec[j]);
+    }
+    i = j + 1;
+    for (int k = low; k <= p; k++) std::swap(vec[k], vec[j--]);
+    for (int k = high; k >= q; k--) std::swap(vec[k], vec[i++]);
+    lt = j + 1;
+    gt = i - 1;
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "hugepage_alloc.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define RADIX_SORT_X86 1
+#endif
+
+// Parallel LSD radix sort for integer keys. Each pass distributes the keys
+// by one 8-bit digit, least significant first, into a scratch array and back;
+// the work per key is a load, a histogram increment and a store, so a pass
+// runs at memory bandwidth instead of the n log n comparisons of a quicksort.
+//
+//   count    every thread histograms its static block of the input (all
+//            digits at once on the first read, one digit on later passes)
+//   prefix   the per-thread counts of each bucket are scanned across
+//            threads in parallel, bucket ranges split between threads
+//   scatter  every thread writes its keys to its own slice of each bucket,
+//            so the sort is stable and needs no atomics
+//
+// A digit that is the same in every key (the top 22 bits of keys below
+// 1000000, say) has one bucket holding all n keys and its pass is skipped.
+// Signed keys have the sign bit of their top digit flipped, so negative keys
+// come first.
+//
+// 8-bit digits keep the 256-bucket histogram and the write-combining buffers
+// (256 cache lines, 16 KiB) inside L1; 11-bit digits would need 2048 lines
+// and spill to L2 on every write.
+
+// Below this many keys std::sort wins (the histograms and scratch array
+// cost more than the sort)
+const size_t RADIX_SORT_MIN = 1 << 14;
+
+const int RADIX_SORT_BITS = 8;
+const int RADIX_SORT_BUCKETS = 1 << RADIX_SORT_BITS;
+const int RADIX_SORT_LINE = 64;  // Write-combining buffer line, bytes
+
+// Shared state of one radix_sort call
+template <typename T>
+struct RadixSortState {
+    T* data;
+    T* scratch;
+    size_t n;
+    std::vector<size_t> counts;  // [thread][digit][bucket]
+    std::vector<size_t> totals;  // [digit][bucket], the same for every permutation
+};
+
+inline void radix_sort_barrier() {
+#ifdef _OPENMP
+    #pragma omp barrier
+#endif
+}
+
+// [begin, end) of part `part` out of `parts` near-equal parts of count
+inline void radix_sort_block(size_t count, size_t parts, size_t part, size_t& begin, size_t& end) {
+    size_t share = count / parts, extra = count % parts;
+    begin = part * share + std::min(part, extra);
+    end = begin + share + (part < extra ? 1 : 0);
+}
+
+template <typename T>
+inline unsigned radix_sort_digit(T key, int digit) {
+    typedef typename std::make_unsigned<T>::type U;
+    unsigned d = (unsigned)((U)key >> (digit * RADIX_SORT_BITS)) & (RADIX_SORT_BUCKETS - 1);
+    if (std::is_signed<T>::value && digit == (int)sizeof(T) - 1) d ^= RADIX_SORT_BUCKETS / 2;
+    return d;
+}
+
+// Write `count` buffered keys to dst. A full line is 64-byte aligned in dst
+// (see radix_sort_scatter) and goes out with streaming stores, which skip
+// the read-for-ownership of a line that is written whole anyway.
+template <typename T>
+inline void radix_sort_flush(T* dst, const T* line, int count) {
+#ifdef RADIX_SORT_X86
+    if (count * sizeof(T) == RADIX_SORT_LINE) {
+        for (int i = 0; i < RADIX_SORT_LINE / 16; i++)
+            _mm_stream_si128((__m128i*)dst + i, _mm_load_si128((const __m128i*)line + i));
+        return;
+    }
+#endif
+    memcpy(dst, line, count * sizeof(T));
+}
+
+// Distribute src[begin, end) by `digit` into dst, starting bucket b at
+// next[b]. Keys are staged in one cache line per bucket and written out a
+// line at a time, so the 256 output streams cost 256 line writes instead of
+// scattered single-key stores. Each bucket's first line is cut short at a
+// 64-byte boundary of dst so every later line is aligned.
+template <typename T>
+void radix_sort_scatter(const T* src, T* dst, size_t begin, size_t end, int digit, size_t* next) {
+    const int perLine = RADIX_SORT_LINE / sizeof(T);
+    alignas(RADIX_SORT_LINE) T lines[RADIX_SORT_BUCKETS][RADIX_SORT_LINE / sizeof(T)];
+    int fill[RADIX_SORT_BUCKETS], limit[RADIX_SORT_BUCKETS];
+    for (int b = 0; b < RADIX_SORT_BUCKETS; b++) {
+        fill[b] = 0;
+        limit[b] = perLine - (int)((uintptr_t)(dst + next[b]) % RADIX_SORT_LINE / sizeof(T));
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        T key = src[i];
+        unsigned b = radix_sort_digit(key, digit);
+        lines[b][fill[b]++] = key;
+        if (fill[b] == limit[b]) {
+            radix_sort_flush(dst + next[b], lines[b], fill[b]);
+            next[b] += fill[b];
+            fill[b] = 0;
+            limit[b] = perLine;
+        }
+    }
+    for (int b = 0; b < RADIX_SORT_BUCKETS; b++)
+        if (fill[b]) memcpy(dst + next[b], lines[b], fill[b] * sizeof(T));
+#ifdef RADIX_SORT_X86
+    _mm_sfence();  // Streaming stores visible before the pass barrier
+#endif
+}
+
+// Turn counts[u][digit][b] for the buckets in [first, last) into the number
+// of bucket-b keys held by threads before u
+template <typename T>
+void radix_sort_scan_threads(RadixSortState<T>& s, int team, int digit, size_t first, size_t last) {
+    const int digits = sizeof(T);
+    for (size_t b = first; b < last; b++) {
+        size_t running = 0;
+        for (int u = 0; u < team; u++) {
+            size_t& c = s.counts[((size_t)u * digits + digit) * RADIX_SORT_BUCKETS + b];
+            size_t count = c;
+            c = running;
+            running += count;
+        }
+    }
+}
+
+// The body every thread of the team runs
+template <typename T>
+void radix_sort_worker(RadixSortState<T>& s, int t, int team) {
+    const int digits = sizeof(T);
+    size_t begin, end, first, last;
+    radix_sort_block(s.n, team, t, begin, end);
+    size_t* mine = &s.counts[(size_t)t * digits * RADIX_SORT_BUCKETS];
+
+    // All digit histograms in one read of the input
+    for (size_t i = begin; i < end; i++)
+        for (int d = 0; d < digits; d++) mine[d * RADIX_SORT_BUCKETS + radix_sort_digit(s.data[i], d)]++;
+    radix_sort_barrier();
+
+    // Global bucket totals of every digit, then the first pass's thread offsets
+    radix_sort_block((size_t)digits * RADIX_SORT_BUCKETS, team, t, first, last);
+    for (size_t db = first; db < last; db++) {
+        size_t total = 0;
+        for (int u = 0; u < team; u++) total += s.counts[(size_t)u * digits * RADIX_SORT_BUCKETS + db];
+        s.totals[db] = total;
+    }
+    radix_sort_barrier();
+
+    T* src = s.data;
+    T* dst = s.scratch;
+    bool counted = true;  // counts hold this pass's digit for the current src
+    for (int d = 0; d < digits; d++) {
+        const size_t* total = &s.totals[d * RADIX_SORT_BUCKETS];
+        bool constant = false;
+        for (int b = 0; b < RADIX_SORT_BUCKETS; b++) constant |= total[b] == s.n;
+        if (constant) continue;
+
+        if (!counted) {
+            size_t* hist = mine + d * RADIX_SORT_BUCKETS;
+            std::fill(hist, hist + RADIX_SORT_BUCKETS, 0);
+            for (size_t i = begin; i < end; i++) hist[radix_sort_digit(src[i], d)]++;
+            radix_sort_barrier();
+        }
+        radix_sort_block(RADIX_SORT_BUCKETS, team, t, first, last);
+        radix_sort_scan_threads(s, team, d, first, last);
+        radix_sort_barrier();
+
+        // Bucket starts from the global totals plus this thread's offset in each
+        size_t next[RADIX_SORT_BUCKETS], base = 0;
+        for (int b = 0; b < RADIX_SORT_BUCKETS; b++) {
+            next[b] = base + mine[d * RADIX_SORT_BUCKETS + b];
+            base += total[b];
+        }
+        radix_sort_scatter(src, dst, begin, end, d, next);
+        radix_sort_barrier();
+        std::swap(src, dst);
+        counted = false;
+    }
+
+    // An odd number of passes leaves the keys in the scratch array
+    if (src != s.data) memcpy(s.data + begin, src + begin, (end - begin) * sizeof(T));
+}
+
+// Sort data[0, n) ascending on the OpenMP threads (one thread without OpenMP)
+template <typename T>
+void radix_sort(T* data, size_t n) {
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 8, "radix_sort needs integer keys of up to 64 bits");
+    if (n < RADIX_SORT_MIN) {
+        std::sort(data, data + n);
+        return;
+    }
+
+    RadixSortState<T> s;
+    s.data = data;
+    s.n = n;
+    s.scratch = hugepage_alloc_array<T>(n);
+    if (!s.scratch) {
+        std::sort(data, data + n);
+        return;
+    }
+    s.totals.assign(sizeof(T) * RADIX_SORT_BUCKETS, 0);
+#ifdef _OPENMP
+    s.counts.assign((size_t)omp_get_max_threads() * sizeof(T) * RADIX_SORT_BUCKETS, 0);
+    #pragma omp parallel
+    radix_sort_worker(s, omp_get_thread_num(), omp_get_num_threads());
+#else
+    s.counts.assign(sizeof(T) * RADIX_SORT_BUCKETS, 0);
+    radix_sort_worker(s, 0, 1);
+#endif
+    hugepage_free_array(s.scratch, n);
+}
+
+template <typename T>
+void radix_sort(std::vector<T>& keys) {
+    radix_sort(keys.data(), keys.size());
+}
+
+#endif
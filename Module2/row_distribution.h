@@ -0,0 +1,87 @@
+#ifndef ROW_DISTRIBUTION_H
+#define ROW_DISTRIBUTION_H
+
+#include <vector>
+#include <mpi.h>
+
+// Row partition of an N-row matrix over the ranks of a communicator, in the
+// element counts/displacements MPI_Scatterv and MPI_Gatherv expect. Works for
+// any N and any number of ranks, including ranks that end up with no rows.
+struct RowDistribution {
+    std::vector<int> counts;  // Elements (rows * row_width) per rank
+    std::vector<int> displs;  // Element offset of each rank's first row
+    int row_width;
+
+    int rows(int rank) const { return counts[rank] / row_width; }
+    int first_row(int rank) const { return displs[rank] / row_width; }
+};
+
+// Hand rank r the rows [first[r], first[r] + rows[r])
+inline RowDistribution row_distribution_from_rows(const std::vector<int>& rows, int row_width) {
+    RowDistribution dist;
+    dist.row_width = row_width;
+    int offset = 0;
+    for (int r : rows) {
+        dist.counts.push_back(r * row_width);
+        dist.displs.push_back(offset * row_width);
+        offset += r;
+    }
+    return dist;
+}
+
+// Equal split; the N % ranks leftover rows go one each to the lowest ranks
+inline RowDistribution row_distribution_even(int n, int ranks, int row_width) {
+    std::vector<int> rows(ranks);
+    for (int r = 0; r < ranks; r++) rows[r] = n / ranks + (r < n % ranks ? 1 : 0);
+    return row_distribution_from_rows(rows, row_width);
+}
+
+// Split proportional to `weights` (e.g. measured rows/second per rank) using
+// largest remainders, so the counts always add up to exactly n
+inline RowDistribution row_distribution_weighted(int n, const std::vector<double>& weights, int row_width) {
+    int ranks = (int)weights.size();
+    double total = 0;
+    for (double w : weights) total += w > 0 ? w : 0;
+    if (total <= 0) return row_distribution_even(n, ranks, row_width);
+
+    std::vector<int> rows(ranks);
+    std::vector<double> remainder(ranks);
+    int assigned = 0;
+    for (int r = 0; r < ranks; r++) {
+        double share = (weights[r] > 0 ? weights[r] : 0) / total * n;
+        rows[r] = (int)share;
+        remainder[r] = share - rows[r];
+        assigned += rows[r];
+    }
+    for (; assigned < n; assigned++) {
+        int best = 0;
+        for (int r = 1; r < ranks; r++)
+            if (remainder[r] > remainder[best]) best = r;
+        rows[best]++;
+        remainder[best] = -1;
+    }
+    return row_distribution_from_rows(rows, row_width);
+}
+
+// Time `kernel(sample_rows)` on this rank and return its rows per second.
+// The kernel should run the same local multiply the real job will use.
+template <typename Kernel>
+double measure_rows_per_second(int sample_rows, Kernel kernel) {
+    kernel(sample_rows);  // Warm caches and thread pools
+    double start = MPI_Wtime();
+    kernel(sample_rows);
+    double elapsed = MPI_Wtime() - start;
+    return elapsed > 0 ? sample_rows / elapsed : 0;
+}
+
+// Collective: every rank contributes its own throughput and gets back a
+// partition in which faster ranks take proportionally more rows
+inline RowDistribution row_distribution_measured(int n, int row_width, double rows_per_second, MPI_Comm comm) {
+    int ranks;
+    MPI_Comm_size(comm, &ranks);
+    std::vector<double> weights(ranks);
+    MPI_Allgather(&rows_per_second, 1, MPI_DOUBLE, weights.data(), 1, MPI_DOUBLE, comm);
+    return row_distribution_weighted(n, weights, row_width);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <cstring>
+#include <vector>
+#include "counter_rng.h"
+
+// OpenMP directives that vanish (instead of warning) in the MPI-only
+// programs built without -fopenmp, where the kernels run serially
+#ifdef _OPENMP
+#define SPARSE_OMP(directive) _Pragma(#directive)
+#else
+#define SPARSE_OMP(directive)
+#endif
+
+// Compressed sparse row and column storage with OpenMP SpMV/SpMM/SpGEMM
+// kernels. Work and memory scale with the number of nonzeros (nnz) instead
+// of N^2, which wins once most entries are zero.
+
+// Inputs with fewer than this fraction of nonzeros take the sparse path
+const double SPARSE_DENSITY_THRESHOLD = 0.10;
+
+// Entry `index` of a random test matrix: nonzero (1..9) with probability
+// `density`. The keep/drop draw and the value come from separate streams of
+// `seed` (counter_rng.h), so any slice can be generated on its own.
+inline int sparse_random_entry(uint64_t seed, size_t index, double density) {
+    if (counter_rng_uniform(counter_rng_stream(seed, 0), index) >= density) return 0;
+    return 1 + counter_rng_below(seed, index, 9);
+}
+
+template <typename T>
+struct CsrMatrix {
+    int rows = 0, cols = 0;
+    std::vector<int> row_ptr;  // rows + 1 offsets into col_idx/values
+    std::vector<int> col_idx;
+    std::vector<T> values;
+
+    size_t nnz() const { return values.size(); }
+};
+
+template <typename T>
+struct CscMatrix {
+    int rows = 0, cols = 0;
+    std::vector<int> col_ptr;  // cols + 1 offsets into row_idx/values
+    std::vector<int> row_idx;
+    std::vector<T> values;
+
+    size_t nnz() const { return values.size(); }
+};
+
+// Fraction of nonzero entries in a rows x cols row-major block
+template <typename T>
+double matrix_density(const T* A, int rows, int cols, int lda) {
+    if (rows == 0 || cols == 0) return 0;
+    long long nonzeros = 0;
+    SPARSE_OMP(omp parallel for reduction(+:nonzeros))
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++) nonzeros += A[(size_t)i * lda + j] != 0;
+    return (double)nonzeros / ((double)rows * cols);
+}
+
+template <typename T>
+CsrMatrix<T> csr_from_dense(const T* A, int rows, int cols, int lda) {
+    CsrMatrix<T> csr;
+    csr.rows = rows;
+    csr.cols = cols;
+    csr.row_ptr.assign(rows + 1, 0);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            T value = A[(size_t)i * lda + j];
+            if (value != 0) {
+                csr.col_idx.push_back(j);
+                csr.values.push_back(value);
+            }
+        }
+        csr.row_ptr[i + 1] = (int)csr.values.size();
+    }
+    return csr;
+}
+
+template <typename T>
+CscMatrix<T> csc_from_csr(const CsrMatrix<T>& csr) {
+    CscMatrix<T> csc;
+    csc.rows = csr.rows;
+    csc.cols = csr.cols;
+    csc.col_ptr.assign(csr.cols + 1, 0);
+    csc.row_idx.resize(csr.nnz());
+    csc.values.resize(csr.nnz());
+    for (int c : csr.col_idx) csc.col_ptr[c + 1]++;
+    for (int j = 0; j < csr.cols; j++) csc.col_ptr[j + 1] += csc.col_ptr[j];
+
+    std::vector<int> next(csc.col_ptr.begin(), csc.col_ptr.end() - 1);
+    for (int i = 0; i < csr.rows; i++)
+        for (int p = csr.row_ptr[i]; p < csr.row_ptr[i + 1]; p++) {
+            int slot = next[csr.col_idx[p]]++;
+            csc.row_idx[slot] = i;
+            csc.values[slot] = csr.values[p];
+        }
+    return csc;
+}
+
+template <typename T>
+void csr_to_dense(const CsrMatrix<T>& csr, T* A, int lda) {
+    for (int i = 0; i < csr.rows; i++) {
+        memset(A + (size_t)i * lda, 0, sizeof(T) * csr.cols);
+        for (int p = csr.row_ptr[i]; p < csr.row_ptr[i + 1]; p++) A[(size_t)i * lda + csr.col_idx[p]] = csr.values[p];
+    }
+}
+
+// y = A * x, one row per iteration
+template <typename T>
+void spmv(const CsrMatrix<T>& A, const T* x, T* y) {
+    SPARSE_OMP(omp parallel for schedule(dynamic, 64))
+    for (int i = 0; i < A.rows; i++) {
+        T sum = 0;
+        for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++) sum += A.values[p] * x[A.col_idx[p]];
+        y[i] = sum;
+    }
+}
+
+// y = A * x from column storage: each thread scatters its columns into a
+// private y, then the partial vectors are summed
+template <typename T>
+void spmv(const CscMatrix<T>& A, const T* x, T* y) {
+    memset(y, 0, sizeof(T) * A.rows);
+    SPARSE_OMP(omp parallel)
+    {
+        std::vector<T> local(A.rows, 0);
+        SPARSE_OMP(omp for schedule(dynamic, 64) nowait)
+        for (int j = 0; j < A.cols; j++)
+            for (int p = A.col_ptr[j]; p < A.col_ptr[j + 1]; p++) local[A.row_idx[p]] += A.values[p] * x[j];
+        SPARSE_OMP(omp critical)
+        for (int i = 0; i < A.rows; i++) y[i] += local[i];
+    }
+}
+
+// C = A * B with sparse A and dense row-major B (A.cols x n) and C (A.rows x n)
+template <typename T>
+void spmm(const CsrMatrix<T>& A, const T* B, int ldb, T* C, int ldc, int n) {
+    SPARSE_OMP(omp parallel for schedule(dynamic, 16))
+    for (int i = 0; i < A.rows; i++) {
+        T* c = C + (size_t)i * ldc;
+        memset(c, 0, sizeof(T) * n);
+        for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++) {
+            T a = A.values[p];
+            const T* b = B + (size_t)A.col_idx[p] * ldb;
+            for (int j = 0; j < n; j++) c[j] += a * b[j];
+        }
+    }
+}
+
+// C = A * B with both operands sparse (Gustavson's row-by-row algorithm).
+// A symbolic pass sizes every row of C, then a numeric pass fills it; each
+// thread uses a dense accumulator plus a marker array of length B.cols.
+template <typename T>
+CsrMatrix<T> spgemm(const CsrMatrix<T>& A, const CsrMatrix<T>& B) {
+    CsrMatrix<T> C;
+    C.rows = A.rows;
+    C.cols = B.cols;
+    C.row_ptr.assign(A.rows + 1, 0);
+
+    SPARSE_OMP(omp parallel)
+    {
+        std::vector<int> marker(B.cols, -1);
+        SPARSE_OMP(omp for schedule(dynamic, 64))
+        for (int i = 0; i < A.rows; i++) {
+            int count = 0;
+            for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++) {
+                int k = A.col_idx[p];
+                for (int q = B.row_ptr[k]; q < B.row_ptr[k + 1]; q++)
+                    if (marker[B.col_idx[q]] != i) {
+                        marker[B.col_idx[q]] = i;
+                        count++;
+                    }
+            }
+            C.row_ptr[i + 1] = count;
+        }
+    }
+    for (int i = 0; i < A.rows; i++) C.row_ptr[i + 1] += C.row_ptr[i];
+    C.col_idx.resize(C.row_ptr[A.rows]);
+    C.values.resize(C.row_ptr[A.rows]);
+
+    SPARSE_OMP(omp parallel)
+    {
+        std::vector<int> marker(B.cols, -1);
+        std::vector<T> accum(B.cols, 0);
+        SPARSE_OMP(omp for schedule(dynamic, 64))
+        for (int i = 0; i < A.rows; i++) {
+            int out = C.row_ptr[i];
+            for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; p++) {
+                int k = A.col_idx[p];
+                T a = A.values[p];
+                for (int q = B.row_ptr[k]; q < B.row_ptr[k + 1]; q++) {
+                    int j = B.col_idx[q];
+                    if (marker[j] != i) {
+                        marker[j] = i;
+                        accum[j] = 0;
+                        C.col_idx[out++] = j;
+                    }
+                    accum[j] += a * B.values[q];
+                }
+            }
+            for (int p = C.row_ptr[i]; p < out; p++) C.values[p] = accum[C.col_idx[p]];
+        }
+    }
+    return C;
+}
+
+// C = A * B for dense row-major operands, sending A through the sparse
+// kernel when its density is below SPARSE_DENSITY_THRESHOLD and through
+// `dense` otherwise. Returns true when the sparse path was taken.
+template <typename T, typename DenseMultiply>
+bool multiply_auto(const T* A, const T* B, T* C, int m, int n, int k, DenseMultiply dense) {
+    if (matrix_density(A, m, k, k) < SPARSE_DENSITY_THRESHOLD) {
+        spmm(csr_from_dense(A, m, k, k), B, n, C, n, n);
+        return true;
+    }
+    dense();
+    return false;
+}
+
+#endif
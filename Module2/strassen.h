@@ -0,0 +1,138 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include <omp.h>
+#include "matrix.h"
+
+// Strassen-Winograd multiply: 7 half-size products and 15 additions per level
+// instead of 8 products. Exact for integer element types. Below `cutoff` the
+// recursion switches to gemm_blocked.
+
+// Recursion levels that still spawn the seven products as OpenMP tasks;
+// 7^3 = 343 tasks is plenty to keep any node busy
+const int STRASSEN_TASK_DEPTH = 3;
+
+// Z = X + Y or Z = X - Y over an n x n block
+template <typename T>
+void strassen_add(int n, const T* X, int ldx, const T* Y, int ldy, T* Z, int ldz, bool subtract) {
+    for (int i = 0; i < n; i++) {
+        const T* x = X + (size_t)i * ldx;
+        const T* y = Y + (size_t)i * ldy;
+        T* z = Z + (size_t)i * ldz;
+        if (subtract)
+            for (int j = 0; j < n; j++) z[j] = x[j] - y[j];
+        else
+            for (int j = 0; j < n; j++) z[j] = x[j] + y[j];
+    }
+}
+
+// C = A * B for n x n blocks; n is even at every level above the cutoff
+template <typename T>
+void strassen_recursive(int n, const T* A, int lda, const T* B, int ldb, T* C, int ldc, int cutoff, int depth) {
+    if (n <= cutoff || n % 2 != 0) {
+        for (int i = 0; i < n; i++) memset(C + (size_t)i * ldc, 0, sizeof(T) * n);
+        gemm_blocked(n, n, n, A, lda, B, ldb, C, ldc);
+        return;
+    }
+
+    int h = n / 2;
+    const T *A11 = A, *A12 = A + h, *A21 = A + (size_t)h * lda, *A22 = A21 + h;
+    const T *B11 = B, *B12 = B + h, *B21 = B + (size_t)h * ldb, *B22 = B21 + h;
+    T *C11 = C, *C12 = C + h, *C21 = C + (size_t)h * ldc, *C22 = C21 + h;
+
+    // Operand sums (Winograd's S1..S4 and T1..T4)
+    Matrix<T> S1(h, h), S2(h, h), S3(h, h), S4(h, h);
+    Matrix<T> T1(h, h), T2(h, h), T3(h, h), T4(h, h);
+    strassen_add(h, A21, lda, A22, lda, S1.data(), h, false);
+    strassen_add(h, S1.data(), h, A11, lda, S2.data(), h, true);
+    strassen_add(h, A11, lda, A21, lda, S3.data(), h, true);
+    strassen_add(h, A12, lda, S2.data(), h, S4.data(), h, true);
+    strassen_add(h, B12, ldb, B11, ldb, T1.data(), h, true);
+    strassen_add(h, B22, ldb, T1.data(), h, T2.data(), h, true);
+    strassen_add(h, B22, ldb, B12, ldb, T3.data(), h, true);
+    strassen_add(h, T2.data(), h, B21, ldb, T4.data(), h, true);
+
+    // The seven independent products. Tasks capture raw pointers only; the
+    // buffers outlive them because of the taskwait below.
+    Matrix<T> P[7];
+    T* p[7];
+    for (int i = 0; i < 7; i++) {
+        P[i].resize(h, h);
+        p[i] = P[i].data();
+    }
+    const T *s1 = S1.data(), *s2 = S2.data(), *s3 = S3.data(), *s4 = S4.data();
+    const T *t1 = T1.data(), *t2 = T2.data(), *t3 = T3.data(), *t4 = T4.data();
+    bool spawn = depth < STRASSEN_TASK_DEPTH;
+    int next = depth + 1;
+
+    #pragma omp task if(spawn)
+    strassen_recursive(h, A11, lda, B11, ldb, p[0], h, cutoff, next);
+    #pragma omp task if(spawn)
+    strassen_recursive(h, A12, lda, B21, ldb, p[1], h, cutoff, next);
+    #pragma omp task if(spawn)
+    strassen_recursive(h, s4, h, B22, ldb, p[2], h, cutoff, next);
+    #pragma omp task if(spawn)
+    strassen_recursive(h, A22, lda, t4, h, p[3], h, cutoff, next);
+    #pragma omp task if(spawn)
+    strassen_recursive(h, s1, h, t1, h, p[4], h, cutoff, next);
+    #pragma omp task if(spawn)
+    strassen_recursive(h, s2, h, t2, h, p[5], h, cutoff, next);
+    strassen_recursive(h, s3, h, t3, h, p[6], h, cutoff, next);
+    #pragma omp taskwait
+
+    // C11 = P1 + P2
+    // U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5
+    // C12 = U4 + P3, C21 = U3 - P4, C22 = U3 + P5
+    for (int i = 0; i < h; i++) {
+        const T *p1 = P[0][i], *p2 = P[1][i], *p3 = P[2][i], *p4 = P[3][i];
+        const T *p5 = P[4][i], *p6 = P[5][i], *p7 = P[6][i];
+        T *c11 = C11 + (size_t)i * ldc, *c12 = C12 + (size_t)i * ldc;
+        T *c21 = C21 + (size_t)i * ldc, *c22 = C22 + (size_t)i * ldc;
+        for (int j = 0; j < h; j++) {
+            T u2 = p1[j] + p6[j];
+            T u3 = u2 + p7[j];
+            c11[j] = p1[j] + p2[j];
+            c12[j] = u2 + p5[j] + p3[j];
+            c21[j] = u3 - p4[j];
+            c22[j] = u3 + p5[j];
+        }
+    }
+}
+
+// C = A * B for square n x n matrices. Sizes that do not halve evenly down to
+// the cutoff are zero-padded once up front to the nearest q * 2^levels >= n.
+template <typename T>
+void strassen_multiply(const Matrix<T>& A, const Matrix<T>& B, Matrix<T>& C, int cutoff, int num_threads) {
+    int n = A.rows();
+    if (cutoff < 1) cutoff = 1;
+
+    int levels = 0;
+    while (((n + (1 << levels) - 1) >> levels) > cutoff) levels++;
+    int padded = ((n + (1 << levels) - 1) >> levels) << levels;
+
+    const Matrix<T>* a = &A;
+    const Matrix<T>* b = &B;
+    Matrix<T>* c = &C;
+    Matrix<T> Ap, Bp, Cp;
+    if (padded != n) {
+        Ap.resize(padded, padded);
+        Bp.resize(padded, padded);
+        Cp.resize(padded, padded);
+        for (int i = 0; i < n; i++) {
+            memcpy(Ap[i], A[i], sizeof(T) * n);
+            memcpy(Bp[i], B[i], sizeof(T) * n);
+        }
+        a = &Ap;
+        b = &Bp;
+        c = &Cp;
+    }
+
+    #pragma omp parallel num_threads(num_threads)
+    #pragma omp single
+    strassen_recursive(padded, a->data(), padded, b->data(), padded, c->data(), padded, cutoff, 0);
+
+    if (padded != n)
+        for (int i = 0; i < n; i++) memcpy(C[i], Cp[i], sizeof(T) * n);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SUMMA_H
+#define SUMMA_H
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <mpi.h>
+#include "matrix.h"
+
+// SUMMA (Scalable Universal Matrix Multiplication Algorithm) on a q x q
+// process grid. Rank (r, c) owns block (r, c) of A, B and C; blocks are the
+// near-equal row/column ranges [i * n / q, (i + 1) * n / q), so any N works.
+// For every k the owners of block column k of A broadcast along their grid
+// row and the owners of block row k of B along their grid column, then every
+// rank accumulates C(r, c) += A(r, k) * B(k, c). Memory per rank is
+// O(N^2 / P) and each rank sends O(N^2 / sqrt(P)) words.
+
+struct SummaGrid {
+    MPI_Comm row_comm, col_comm;  // Ranks sharing this grid row / grid column
+    int q;                        // Grid is q x q
+    int row, col;                 // This rank's grid coordinates
+    int n;                        // Global matrix size
+};
+
+inline int summa_block_begin(int n, int q, int i) { return (int)((long)i * n / q); }
+inline int summa_block_size(int n, int q, int i) {
+    return summa_block_begin(n, q, i + 1) - summa_block_begin(n, q, i);
+}
+
+// Split `comm` into a q x q grid. Returns false (and leaves grid untouched)
+// when the communicator size is not a perfect square.
+inline bool summa_grid_create(MPI_Comm comm, int n, SummaGrid& grid) {
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+    int q = (int)lround(sqrt((double)ranks));
+    if (q * q != ranks) return false;
+
+    grid.q = q;
+    grid.n = n;
+    grid.row = rank / q;
+    grid.col = rank % q;
+    MPI_Comm_split(comm, grid.row, grid.col, &grid.row_comm);
+    MPI_Comm_split(comm, grid.col, grid.row, &grid.col_comm);
+    return true;
+}
+
+inline void summa_grid_free(SummaGrid& grid) {
+    MPI_Comm_free(&grid.row_comm);
+    MPI_Comm_free(&grid.col_comm);
+}
+
+// Dimensions of this rank's block of C (and of A and B, since all are N x N)
+inline int summa_local_rows(const SummaGrid& grid) { return summa_block_size(grid.n, grid.q, grid.row); }
+inline int summa_local_cols(const SummaGrid& grid) { return summa_block_size(grid.n, grid.q, grid.col); }
+
+// C(row, col) = sum over k of A(row, k) * B(k, col). A_local, B_local and
+// C_local are this rank's row-major blocks; C_local is overwritten.
+inline void summa_multiply(const SummaGrid& grid, const int* A_local, const int* B_local, int* C_local) {
+    int rows = summa_local_rows(grid);
+    int cols = summa_local_cols(grid);
+    int widest = (grid.n + grid.q - 1) / grid.q;  // No block is wider than ceil(N / q)
+    std::vector<int> panelA((size_t)rows * widest), panelB((size_t)widest * cols);
+
+    memset(C_local, 0, sizeof(int) * rows * cols);
+    for (int k = 0; k < grid.q; k++) {
+        int kw = summa_block_size(grid.n, grid.q, k);
+
+        // A(row, k) travels along the grid row from the rank in column k
+        if (grid.col == k) memcpy(panelA.data(), A_local, sizeof(int) * rows * kw);
+        MPI_Bcast(panelA.data(), rows * kw, MPI_INT, k, grid.row_comm);
+
+        // B(k, col) travels along the grid column from the rank in row k
+        if (grid.row == k) memcpy(panelB.data(), B_local, sizeof(int) * kw * cols);
+        MPI_Bcast(panelB.data(), kw * cols, MPI_INT, k, grid.col_comm);
+
+        gemm_blocked(rows, cols, kw, panelA.data(), kw, panelB.data(), cols, C_local, cols);
+    }
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <pthread.h>
+
+// Persistent pthread pool for running many parallel loops back to back.
+// Workers are created once and sleep on a condition variable between jobs.
+// parallel_for hands out chunks of the iteration space from a shared atomic
+// counter, so fast threads take more chunks and no remainder is left over.
+// parallel_for_static instead deals chunks round-robin by thread index, for
+// loops whose data was first touched in that same pattern (NUMA placement).
+class ThreadPool {
+public:
+    // `threads` workers in total, counting the calling thread. `on_start`,
+    // if given, runs once on every thread with its index (0 is the caller),
+    // e.g. to pin it to a core before any job runs.
+    explicit ThreadPool(int threads, const std::function<void(int)>& on_start = nullptr)
+        : generation_(0), stopping_(false), pending_(0), on_start_(on_start), started_(0) {
+        pthread_mutex_init(&mutex_, NULL);
+        pthread_cond_init(&wake_, NULL);
+        pthread_cond_init(&done_, NULL);
+        if (on_start_) on_start_(0);
+        workers_.resize(threads > 1 ? threads - 1 : 0);
+        for (pthread_t& worker : workers_) pthread_create(&worker, NULL, worker_main, this);
+    }
+
+    ~ThreadPool() {
+        pthread_mutex_lock(&mutex_);
+        stopping_ = true;
+        pthread_cond_broadcast(&wake_);
+        pthread_mutex_unlock(&mutex_);
+        for (pthread_t& worker : workers_) pthread_join(worker, NULL);
+        pthread_cond_destroy(&done_);
+        pthread_cond_destroy(&wake_);
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers_.size() + 1; }
+
+    // Call body(begin, end) for consecutive chunks of at most `chunk`
+    // iterations covering [0, count). Returns once every chunk has run.
+    void parallel_for(int count, int chunk, const std::function<void(int, int)>& body) {
+        run(count, chunk, false, body);
+    }
+
+    // Same chunks, but thread t (0 is the caller, workers in on_start order)
+    // runs exactly chunks t, t + size(), t + 2 * size(), ..., like an OpenMP
+    // schedule(static, chunk) loop with the same thread count
+    void parallel_for_static(int count, int chunk, const std::function<void(int, int)>& body) {
+        run(count, chunk, true, body);
+    }
+
+private:
+    void run(int count, int chunk, bool fixed, const std::function<void(int, int)>& body) {
+        if (count <= 0) return;
+        if (chunk < 1) chunk = 1;
+
+        pthread_mutex_lock(&mutex_);
+        body_ = &body;
+        count_ = count;
+        chunk_ = chunk;
+        static_ = fixed;
+        next_.store(0);
+        pending_ = (int)workers_.size();
+        generation_++;
+        pthread_cond_broadcast(&wake_);
+        pthread_mutex_unlock(&mutex_);
+
+        run_chunks(0);
+
+        pthread_mutex_lock(&mutex_);
+        while (pending_ > 0) pthread_cond_wait(&done_, &mutex_);
+        body_ = NULL;
+        pthread_mutex_unlock(&mutex_);
+    }
+
+    void run_chunks(int thread) {
+        if (static_) {
+            for (long begin = (long)thread * chunk_; begin < count_; begin += (long)chunk_ * size())
+                (*body_)((int)begin, (int)std::min<long>(begin + chunk_, count_));
+            return;
+        }
+        for (;;) {
+            int begin = next_.fetch_add(chunk_);
+            if (begin >= count_) return;
+            int end = begin + chunk_ < count_ ? begin + chunk_ : count_;
+            (*body_)(begin, end);
+        }
+    }
+
+    static void* worker_main(void* arg) {
+        ThreadPool* pool = (ThreadPool*)arg;
+        int thread = pool->started_.fetch_add(1) + 1;
+        if (pool->on_start_) pool->on_start_(thread);
+        unsigned long seen = 0;
+        for (;;) {
+            pthread_mutex_lock(&pool->mutex_);
+            while (!pool->stopping_ && pool->generation_ == seen) pthread_cond_wait(&pool->wake_, &pool->mutex_);
+            if (pool->stopping_) {
+                pthread_mutex_unlock(&pool->mutex_);
+                return NULL;
+            }
+            seen = pool->generation_;
+            pthread_mutex_unlock(&pool->mutex_);
+
+            pool->run_chunks(thread);
+
+            pthread_mutex_lock(&pool->mutex_);
+            if (--pool->pending_ == 0) pthread_cond_signal(&pool->done_);
+            pthread_mutex_unlock(&pool->mutex_);
+        }
+    }
+
+    std::vector<pthread_t> workers_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t wake_, done_;
+    unsigned long generation_;
+    bool stopping_;
+    int pending_;  // Workers that have not finished the current job
+    std::function<void(int)> on_start_;
+    std::atomic<int> started_;
+
+    const std::function<void(int, int)>* body_;
+    int count_, chunk_;
+    bool static_;  // parallel_for_static: chunks by thread index, not from next_
+    std::atomic<int> next_;
+};
+
+#endif
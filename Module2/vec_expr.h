@@ -0,0 +1,216 @@
+#ifndef VEC_EXPR_H
+#define VEC_EXPR_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "hugepage_alloc.h"
+
+// Lazy elementwise vector expressions. Arithmetic on Vec<T> does not compute
+// anything; it builds a small expression object that knows how to produce
+// element i. Assigning the expression to a Vec (or reducing it with sum)
+// evaluates the whole tree in one OpenMP parallel SIMD loop, so
+//
+//   v3 = clamp(2 * v1 + v2, 0, 150);
+//
+// reads v1 and v2 and writes v3 once, instead of one memory pass per step.
+// The expression types are all inlined away; element i of the tree above
+// compiles to the same few instructions a hand-fused loop would.
+
+// CRTP base of every expression: E provides size(), operator[](i) and value_type
+template <typename E>
+struct VecExpr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template <typename T>
+class Vec;
+
+// Vectors are held by reference inside expressions (they outlive the
+// statement), everything else by value
+template <typename E>
+struct VecOperand {
+    typedef const E type;
+};
+template <typename T>
+struct VecOperand<Vec<T>> {
+    typedef const Vec<T>& type;
+};
+
+// A scalar broadcast over the other operand's length (size 0 = any length)
+template <typename T>
+struct VecScalar : VecExpr<VecScalar<T>> {
+    typedef T value_type;
+    T value;
+
+    explicit VecScalar(T v) : value(v) {}
+    size_t size() const { return 0; }
+    T operator[](size_t) const { return value; }
+};
+
+template <typename Op, typename L, typename R>
+struct VecBinary : VecExpr<VecBinary<Op, L, R>> {
+    typedef typename L::value_type value_type;
+    typename VecOperand<L>::type left;
+    typename VecOperand<R>::type right;
+
+    VecBinary(const L& l, const R& r) : left(l), right(r) {
+        assert(l.size() == 0 || r.size() == 0 || l.size() == r.size());
+    }
+    size_t size() const { return left.size() ? left.size() : right.size(); }
+    value_type operator[](size_t i) const { return Op::apply(left[i], right[i]); }
+};
+
+struct VecAdd {
+    template <typename T> static T apply(T a, T b) { return a + b; }
+};
+struct VecSub {
+    template <typename T> static T apply(T a, T b) { return a - b; }
+};
+struct VecMul {
+    template <typename T> static T apply(T a, T b) { return a * b; }
+};
+struct VecMin {
+    template <typename T> static T apply(T a, T b) { return b < a ? b : a; }
+};
+struct VecMax {
+    template <typename T> static T apply(T a, T b) { return a < b ? b : a; }
+};
+
+// Contiguous, huge-page backed vector (see hugepage_alloc.h)
+template <typename T>
+class Vec : public VecExpr<Vec<T>> {
+public:
+    typedef T value_type;
+
+    // n zeroed elements, first touched by the OpenMP threads in the same
+    // static blocks every evaluation loop uses, so each thread's block is on
+    // its own NUMA node. Throws std::bad_alloc when the mapping fails.
+    explicit Vec(size_t n) : size_(n), data_(hugepage_alloc_array<T>(n, &pages_)) {
+        if (!data_) throw std::bad_alloc();
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) data_[i] = T();
+    }
+    ~Vec() { hugepage_free_array(data_, size_); }
+
+    Vec(Vec&& other) noexcept : size_(other.size_), data_(other.data_), pages_(other.pages_) {
+        other.size_ = 0;
+        other.data_ = nullptr;
+    }
+    Vec(const Vec&) = delete;
+
+    Vec& operator=(const Vec& other) { return *this = static_cast<const VecExpr<Vec>&>(other); }
+
+    // Evaluate an expression into this vector in one fused pass
+    template <typename E>
+    Vec& operator=(const VecExpr<E>& expr) {
+        const E& e = expr.self();
+        assert(e.size() == 0 || e.size() == size_);
+        T* out = data_;
+        #pragma omp parallel for simd schedule(static)
+        for (size_t i = 0; i < size_; i++) out[i] = e[i];
+        return *this;
+    }
+
+    Vec& operator=(T value) { return *this = VecScalar<T>(value); }
+
+    size_t size() const { return size_; }
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    T& operator[](size_t i) { return data_[i]; }
+    T operator[](size_t i) const { return data_[i]; }
+    HugePageKind pages() const { return pages_; }
+
+private:
+    size_t size_;
+    T* data_;
+    HugePageKind pages_;
+};
+
+// Integer sums accumulate in 64 bits, floating-point ones in double
+template <typename T>
+struct VecSum {
+    typedef typename std::conditional<std::is_integral<T>::value, long long, double>::type type;
+};
+
+// Sum of an expression's elements without storing them anywhere
+template <typename E>
+typename VecSum<typename E::value_type>::type sum(const VecExpr<E>& expr) {
+    const E& e = expr.self();
+    typename VecSum<typename E::value_type>::type total = 0;
+    size_t n = e.size();
+    #pragma omp parallel for simd schedule(static) reduction(+:total)
+    for (size_t i = 0; i < n; i++) total += e[i];
+    return total;
+}
+
+// out = expr and the sum of the new out, still in a single pass
+template <typename T, typename E>
+typename VecSum<T>::type assign_and_sum(Vec<T>& out, const VecExpr<E>& expr) {
+    const E& e = expr.self();
+    assert(e.size() == 0 || e.size() == out.size());
+    typename VecSum<T>::type total = 0;
+    T* dst = out.data();
+    size_t n = out.size();
+    #pragma omp parallel for simd schedule(static) reduction(+:total)
+    for (size_t i = 0; i < n; i++) {
+        T value = e[i];
+        dst[i] = value;
+        total += value;
+    }
+    return total;
+}
+
+// Operators: expression with expression, and either side with a scalar of
+// the expression's element type
+
+#define VEC_EXPR_OPERATOR(op, Op)                                                                     \
+    template <typename L, typename R>                                                                 \
+    VecBinary<Op, L, R> operator op(const VecExpr<L>& l, const VecExpr<R>& r) {                       \
+        return VecBinary<Op, L, R>(l.self(), r.self());                                               \
+    }                                                                                                 \
+    template <typename L>                                                                             \
+    VecBinary<Op, L, VecScalar<typename L::value_type>> operator op(const VecExpr<L>& l,              \
+                                                                    typename L::value_type s) {       \
+        return VecBinary<Op, L, VecScalar<typename L::value_type>>(l.self(), VecScalar<typename L::value_type>(s)); \
+    }                                                                                                 \
+    template <typename R>                                                                             \
+    VecBinary<Op, VecScalar<typename R::value_type>, R> operator op(typename R::value_type s,          \
+                                                                    const VecExpr<R>& r) {            \
+        return VecBinary<Op, VecScalar<typename R::value_type>, R>(VecScalar<typename R::value_type>(s), r.self()); \
+    }
+
+VEC_EXPR_OPERATOR(+, VecAdd)
+VEC_EXPR_OPERATOR(-, VecSub)
+VEC_EXPR_OPERATOR(*, VecMul)
+#undef VEC_EXPR_OPERATOR
+
+template <typename L>
+VecBinary<VecMin, L, VecScalar<typename L::value_type>> vmin(const VecExpr<L>& l, typename L::value_type s) {
+    return VecBinary<VecMin, L, VecScalar<typename L::value_type>>(l.self(), VecScalar<typename L::value_type>(s));
+}
+
+template <typename L>
+VecBinary<VecMax, L, VecScalar<typename L::value_type>> vmax(const VecExpr<L>& l, typename L::value_type s) {
+    return VecBinary<VecMax, L, VecScalar<typename L::value_type>>(l.self(), VecScalar<typename L::value_type>(s));
+}
+
+template <typename L, typename R>
+VecBinary<VecMin, L, R> vmin(const VecExpr<L>& l, const VecExpr<R>& r) {
+    return VecBinary<VecMin, L, R>(l.self(), r.self());
+}
+
+template <typename L, typename R>
+VecBinary<VecMax, L, R> vmax(const VecExpr<L>& l, const VecExpr<R>& r) {
+    return VecBinary<VecMax, L, R>(l.self(), r.self());
+}
+
+// Each element limited to [lo, hi]
+template <typename E>
+auto clamp(const VecExpr<E>& e, typename E::value_type lo, typename E::value_type hi) -> decltype(vmin(vmax(e, lo), hi)) {
+    return vmin(vmax(e, lo), hi);
+}
+
+#endif
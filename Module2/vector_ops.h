@@ -0,0 +1,110 @@
+#ifndef VECTOR_OPS_H
+#define VECTOR_OPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECTOR_OPS_X86 1
+#endif
+
+// c = a + b and the sum of c in one pass: every element of c is added to the
+// total while it is still in a register, so the sum costs no extra trip
+// through memory. The sum is accumulated in 64 bits, so 100M elements of
+// a few hundred each cannot overflow it.
+
+inline long long add_and_sum_scalar(const int* a, const int* b, int* c, size_t n) {
+    long long sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        c[i] = a[i] + b[i];
+        sum += c[i];
+    }
+    return sum;
+}
+
+#ifdef VECTOR_OPS_X86
+// 8 ints per step; the sums are widened to two 4 x int64 accumulators
+__attribute__((target("avx2")))
+inline long long add_and_sum_avx2(const int* a, const int* b, int* c, size_t n) {
+    __m256i sumLo = _mm256_setzero_si256(), sumHi = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                     _mm256_loadu_si256((const __m256i*)(b + i)));
+        _mm256_storeu_si256((__m256i*)(c + i), v);
+        sumLo = _mm256_add_epi64(sumLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        sumHi = _mm256_add_epi64(sumHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(sumLo, sumHi));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + add_and_sum_scalar(a + i, b + i, c + i, n - i);
+}
+#endif
+
+inline long long add_and_sum(const int* a, const int* b, int* c, size_t n) {
+#ifdef VECTOR_OPS_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) return add_and_sum_avx2(a, b, c, n);
+#endif
+    return add_and_sum_scalar(a, b, c, n);
+}
+
+// c = a + b with non-temporal (streaming) stores for c. A normal store
+// first reads the destination line into cache (read-for-ownership) and later
+// evicts it; a streaming store writes the line straight to memory, so a
+// result that is not read again soon costs one memory pass instead of two
+// and does not push a and b out of cache. Stores before the first aligned
+// vector and after the last one are ordinary.
+
+inline void add_scalar(const int* a, const int* b, int* c, size_t n) {
+    for (size_t i = 0; i < n; i++) c[i] = a[i] + b[i];
+}
+
+#ifdef VECTOR_OPS_X86
+__attribute__((target("avx2")))
+inline void add_stream_avx2(const int* a, const int* b, int* c, size_t n) {
+    size_t head = ((32 - (size_t)c % 32) % 32) / sizeof(int);
+    if (head > n || (size_t)c % sizeof(int) != 0) return add_scalar(a, b, c, n);
+    add_scalar(a, b, c, head);
+    size_t i = head;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                     _mm256_loadu_si256((const __m256i*)(b + i)));
+        _mm256_stream_si256((__m256i*)(c + i), v);
+    }
+    _mm_sfence();  // Order the streaming stores before anything that follows
+    add_scalar(a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+inline void add_stream_avx512(const int* a, const int* b, int* c, size_t n) {
+    size_t head = ((64 - (size_t)c % 64) % 64) / sizeof(int);
+    if (head > n || (size_t)c % sizeof(int) != 0) return add_scalar(a, b, c, n);
+    add_scalar(a, b, c, head);
+    size_t i = head;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_add_epi32(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        _mm512_stream_si512((__m512i*)(c + i), v);
+    }
+    _mm_sfence();
+    add_scalar(a + i, b + i, c + i, n - i);
+}
+#endif
+
+inline void add_stream(const int* a, const int* b, int* c, size_t n) {
+#ifdef VECTOR_OPS_X86
+    static const int isa = __builtin_cpu_supports("avx512f") ? 512 : __builtin_cpu_supports("avx2") ? 256 : 0;
+    if (isa == 512) return add_stream_avx512(a, b, c, n);
+    if (isa == 256) return add_stream_avx2(a, b, c, n);
+#endif
+    add_scalar(a, b, c, n);
+}
+
+// Memory traffic of c = a + b over n ints (two streams read, one written),
+// in GB/s for a run of `seconds`
+inline double add_bandwidth_gbs(size_t n, double seconds) {
+    return 3.0 * n * sizeof(int) / seconds / 1e9;
+}
+
+#endif
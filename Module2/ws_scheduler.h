@@ -0,0 +1,322 @@
+#ifndef WS_SCHEDULER_H
+#define WS_SCHEDULER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// Work-stealing runtime for recursive divide and conquer on pthreads.
+//
+// Every worker owns a Chase-Lev deque. A task spawned by a worker goes on
+// the bottom of its own deque and the worker keeps taking from the bottom
+// (newest, smallest piece first, still warm in cache); an idle worker
+// steals from the top of a random victim's deque, which holds the oldest
+// and so largest pieces. Work flows to whichever core runs out, however
+// unevenly a recursion splits, and the owner's push/take touch only its own
+// deque (no lock, one CAS when the last task is contended).
+//
+//   WsScheduler scheduler(threads);
+//   scheduler.run([&] {
+//       WsTaskGroup group;
+//       group.spawn([&] { left(); });
+//       right();
+//       group.wait();  // runs or steals other tasks until left() is done
+//   });
+//
+// Spawn and wait only inside run() (on the scheduler's threads). A task
+// may itself spawn into the same or a new group.
+
+// Worker count: WS_THREADS from the environment, else the core count
+inline int ws_default_threads() {
+    const char* env = getenv("WS_THREADS");
+    if (env && atoi(env) > 0) return atoi(env);
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
+
+struct WsTaskGroup;
+
+struct WsTask {
+    std::function<void()> fn;
+    WsTaskGroup* group;
+};
+
+// Chase-Lev work-stealing deque (with the C11 memory orders of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models"). The owner
+// pushes and takes at the bottom, thieves steal at the top. The ring grows
+// by doubling; old rings are kept until the deque dies, since a thief may
+// still be reading one.
+class WsDeque {
+public:
+    WsDeque() : top_(0), bottom_(0) {
+        rings_.push_back(new Ring(64));
+        ring_.store(rings_.back(), std::memory_order_relaxed);
+    }
+    ~WsDeque() {
+        for (Ring* ring : rings_) delete ring;
+    }
+
+    WsDeque(const WsDeque&) = delete;
+    WsDeque& operator=(const WsDeque&) = delete;
+
+    // Owner only
+    void push(WsTask* task) {
+        long b = bottom_.load(std::memory_order_relaxed);
+        long t = top_.load(std::memory_order_acquire);
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+        if (b - t > ring->mask) ring = grow(ring, t, b);
+        ring->slot(b).store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only: newest task, or nullptr
+    WsTask* take() {
+        long b = bottom_.load(std::memory_order_relaxed) - 1;
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        WsTask* task = ring->slot(b).load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last task: race the thieves for it
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                task = nullptr;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread; only a hint, the deque may change right after
+    bool empty() const {
+        return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+    }
+
+    // Any thread: oldest task, or nullptr if empty or another thread won it
+    WsTask* steal() {
+        long t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        Ring* ring = ring_.load(std::memory_order_acquire);
+        WsTask* task = ring->slot(t).load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return task;
+    }
+
+private:
+    struct Ring {
+        explicit Ring(long size) : mask(size - 1), slots(new std::atomic<WsTask*>[size]) {}
+        ~Ring() { delete[] slots; }
+        std::atomic<WsTask*>& slot(long i) { return slots[i & mask]; }
+        long mask;
+        std::atomic<WsTask*>* slots;
+    };
+
+    Ring* grow(Ring* old, long t, long b) {
+        Ring* ring = new Ring(2 * (old->mask + 1));
+        for (long i = t; i < b; i++) ring->slot(i).store(old->slot(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+        rings_.push_back(ring);
+        ring_.store(ring, std::memory_order_release);
+        return ring;
+    }
+
+    // top and bottom on separate cache lines: thieves hammer one, the owner the other
+    alignas(64) std::atomic<long> top_;
+    alignas(64) std::atomic<long> bottom_;
+    std::atomic<Ring*> ring_;
+    std::vector<Ring*> rings_;  // Owner only
+};
+
+class WsScheduler {
+public:
+    // `threads` workers in total, counting the thread that calls run()
+    explicit WsScheduler(int threads = ws_default_threads())
+        : deques_(threads > 1 ? threads : 1), tasks_run_(deques_.size()), running_(false), stopping_(false),
+          idle_(0), epoch_(0) {
+        pthread_mutex_init(&mutex_, NULL);
+        pthread_cond_init(&wake_, NULL);
+        threads_.resize(deques_.size() - 1);
+        starts_.reserve(threads_.size());
+        for (size_t w = 0; w < threads_.size(); w++) {
+            starts_.push_back({ this, (int)w + 1 });
+            pthread_create(&threads_[w], NULL, worker_main, &starts_[w]);
+        }
+    }
+
+    ~WsScheduler() {
+        stopping_.store(true);
+        notify();
+        for (pthread_t& thread : threads_) pthread_join(thread, NULL);
+        pthread_cond_destroy(&wake_);
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    WsScheduler(const WsScheduler&) = delete;
+    WsScheduler& operator=(const WsScheduler&) = delete;
+
+    int size() const { return (int)deques_.size(); }
+
+    // Run root on the calling thread as worker 0, with the other workers
+    // stealing whatever it spawns. Returns when root returns; root waits on
+    // its groups, so all of its work is done by then.
+    void run(const std::function<void()>& root) {
+        assert(!current().scheduler && "WsScheduler::run is not reentrant");
+        for (Counter& count : tasks_run_) count.value.store(0);
+        current() = { this, 0 };
+        running_.store(true);
+        notify();
+        root();
+        running_.store(false);
+        current() = { nullptr, 0 };
+    }
+
+    // Tasks worker w ran (its own and stolen ones) during the last run()
+    long tasks_run(int worker) const { return tasks_run_[worker].value.load(); }
+
+private:
+    friend struct WsTaskGroup;
+
+    struct Current {
+        WsScheduler* scheduler;
+        int worker;
+    };
+
+    static Current& current() {
+        static thread_local Current self = { nullptr, 0 };
+        return self;
+    }
+
+    struct Counter {
+        alignas(64) std::atomic<long> value;
+    };
+
+    void spawn(WsTask* task) {
+        Current& self = current();
+        assert(self.scheduler == this && "spawn outside WsScheduler::run");
+        deques_[self.worker].push(task);
+        // Pairs with the fence in idle(): either a sleeper sees the new
+        // task on its final scan or we see it counted and wake it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle_.load(std::memory_order_relaxed) > 0) notify();
+    }
+
+    // Run one task: the worker's own newest, else one stolen from a random
+    // victim. False if nothing was found.
+    bool run_one(int worker, unsigned& rng) {
+        WsTask* task = deques_[worker].take();
+        for (int tries = 0; !task && tries < 2 * size(); tries++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            int victim = rng % size();
+            if (victim != worker) task = deques_[victim].steal();
+        }
+        if (!task) return false;
+        execute(task);
+        tasks_run_[worker].value.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    inline void execute(WsTask* task);
+
+    void notify() {
+        pthread_mutex_lock(&mutex_);
+        epoch_++;
+        pthread_cond_broadcast(&wake_);
+        pthread_mutex_unlock(&mutex_);
+    }
+
+    // Sleep until a spawn, the start of a run, or shutdown. A final scan of
+    // every deque after announcing ourselves idle closes the race with a
+    // spawn that looked at idle_ just before.
+    void idle(int worker) {
+        idle_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        pthread_mutex_lock(&mutex_);
+        unsigned long seen = epoch_;
+        pthread_mutex_unlock(&mutex_);
+
+        bool work = false;
+        for (int w = 0; w < size() && !work; w++)
+            work = w != worker && !deques_[w].empty();
+        if (!work) {
+            pthread_mutex_lock(&mutex_);
+            while (epoch_ == seen && !stopping_.load()) pthread_cond_wait(&wake_, &mutex_);
+            pthread_mutex_unlock(&mutex_);
+        }
+        idle_.fetch_sub(1);
+    }
+
+    static void* worker_main(void* arg) {
+        Current start = *(Current*)arg;
+        WsScheduler* self = start.scheduler;
+        current() = start;
+        unsigned rng = 2463534242u * (start.worker + 1);
+        int misses = 0;
+        while (!self->stopping_.load()) {
+            if (self->running_.load() && self->run_one(start.worker, rng)) {
+                misses = 0;
+            } else if (++misses < 64) {
+                sched_yield();
+            } else {
+                self->idle(start.worker);
+                misses = 0;
+            }
+        }
+        return NULL;
+    }
+
+    std::vector<WsDeque> deques_;
+    std::vector<Counter> tasks_run_;
+    std::vector<pthread_t> threads_;
+    std::vector<Current> starts_;
+    std::atomic<bool> running_, stopping_;
+    std::atomic<int> idle_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t wake_;
+    unsigned long epoch_;  // Bumped under mutex_ by every notify
+};
+
+// A set of spawned tasks that wait() joins. Tasks may spawn more tasks into
+// the same group; wait() returns when all of them have finished.
+struct WsTaskGroup {
+    WsTaskGroup() : pending(0) {}
+    ~WsTaskGroup() { assert(pending.load() == 0 && "WsTaskGroup destroyed before wait()"); }
+
+    void spawn(const std::function<void()>& fn) {
+        WsScheduler* scheduler = WsScheduler::current().scheduler;
+        assert(scheduler && "spawn outside WsScheduler::run");
+        pending.fetch_add(1, std::memory_order_relaxed);
+        scheduler->spawn(new WsTask{ fn, this });
+    }
+
+    // Run or steal other tasks until this group's tasks are done, so the
+    // waiting thread never sits idle while there is work anywhere
+    void wait() {
+        WsScheduler::Current self = WsScheduler::current();
+        unsigned rng = 2463534242u * (self.worker + 1);
+        while (pending.load(std::memory_order_acquire) > 0)
+            if (!self.scheduler->run_one(self.worker, rng)) sched_yield();
+    }
+
+    std::atomic<long> pending;
+};
+
+inline void WsScheduler::execute(WsTask* task) {
+    task->fn();
+    task->group->pending.fetch_sub(1, std::memory_order_release);
+    delete task;
+}
+
+#endif